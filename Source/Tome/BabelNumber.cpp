@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BabelNumber.h"
+
+bool FBabelNumber::IsZero() const
+{
+	for (int32 i = 0; i < limbCount; i++)
+	{
+		if (limbs[i] != 0)
+			return false;
+	}
+	return true;
+}
+
+int32 FBabelNumber::Compare(const FBabelNumber &other) const
+{
+	for (int32 i = limbCount - 1; i >= 0; i--)
+	{
+		if (limbs[i] != other.limbs[i])
+			return limbs[i] < other.limbs[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+int32 FBabelNumber::BitLength() const
+{
+	for (int32 i = limbCount - 1; i >= 0; i--)
+	{
+		if (limbs[i] != 0)
+			return i * 32 + 32 - int32(FPlatformMath::CountLeadingZeros(limbs[i]));
+	}
+	return 0;
+}
+
+uint32 FBabelNumber::MultiplyAdd(uint32 factor, uint32 add)
+{
+	uint64 carry = add;
+	for (int32 i = 0; i < limbCount; i++)
+	{
+		uint64 value = uint64(limbs[i]) * factor + carry;
+		limbs[i] = uint32(value);
+		carry = value >> 32;
+	}
+	return uint32(carry);
+}
+
+void FBabelNumber::Add(const FBabelNumber &other)
+{
+	uint64 carry = 0;
+	for (int32 i = 0; i < limbCount; i++)
+	{
+		uint64 value = uint64(limbs[i]) + other.limbs[i] + carry;
+		limbs[i] = uint32(value);
+		carry = value >> 32;
+	}
+}
+
+void FBabelNumber::Subtract(const FBabelNumber &other)
+{
+	uint64 borrow = 0;
+	for (int32 i = 0; i < limbCount; i++)
+	{
+		uint64 value = uint64(limbs[i]) - other.limbs[i] - borrow;
+		limbs[i] = uint32(value);
+		borrow = (value >> 32) & 1;
+	}
+}
+
+void FBabelNumber::Mask(int32 bits)
+{
+	int32 whole = FMath::Clamp(bits, 0, bitCount) / 32;
+	if (whole < limbCount && bits % 32 != 0)
+		limbs[whole++] &= (uint32(1) << (bits % 32)) - 1;
+
+	for (int32 i = whole; i < limbCount; i++)
+		limbs[i] = 0;
+}
+
+void FBabelNumber::XorShiftRight(int32 shift)
+{
+	int32 offset = shift / 32;
+	int32 bits = shift % 32;
+
+	// Ascending, so each limb read is at or above the one being written
+	for (int32 i = 0; i + offset < limbCount; i++)
+	{
+		uint32 shifted = limbs[i + offset] >> bits;
+		if (bits != 0 && i + offset + 1 < limbCount)
+			shifted |= limbs[i + offset + 1] << (32 - bits);
+		limbs[i] ^= shifted;
+	}
+}
+
+FBabelNumber FBabelNumber::MultiplyLow(const FBabelNumber &a, const FBabelNumber &b)
+{
+	FBabelNumber result;
+	for (int32 i = 0; i < limbCount; i++)
+	{
+		if (a.limbs[i] == 0)
+			continue;
+
+		uint64 carry = 0;
+		for (int32 j = 0; i + j < limbCount; j++)
+		{
+			uint64 value = uint64(a.limbs[i]) * b.limbs[j] + result.limbs[i + j] + carry;
+			result.limbs[i + j] = uint32(value);
+			carry = value >> 32;
+		}
+	}
+	return result;
+}
+
+FBabelNumber FBabelNumber::InverseOdd(const FBabelNumber &a)
+{
+	// Odd numbers are their own inverse modulo 8, each step doubles the correct bits
+	uint32 low = a.limbs[0];
+	for (int32 i = 0; i < 4; i++)
+		low *= 2 - a.limbs[0] * low;
+
+	FBabelNumber inverse(low);
+	for (int32 bits = 32; bits < bitCount; bits *= 2)
+	{
+		// inverse *= 2 - a * inverse
+		FBabelNumber correction(2);
+		correction.Subtract(MultiplyLow(a, inverse));
+		inverse = MultiplyLow(inverse, correction);
+	}
+	return inverse;
+}
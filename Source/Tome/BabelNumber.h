@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Unsigned integer of a fixed number of 32 bit limbs, wide enough for a page of text read as a base 29 number.
+// Arithmetic wraps at the full width, callers mask down to the bits they use
+struct TOME_API FBabelNumber
+{
+	static const int32 limbCount = 55;
+	static const int32 bitCount = limbCount * 32;
+
+	uint32 limbs[limbCount]; // Least significant first
+
+	FBabelNumber() { FMemory::Memzero(limbs); }
+	explicit FBabelNumber(uint32 value) : FBabelNumber() { limbs[0] = value; }
+
+	bool IsZero() const;
+
+	// Less than zero if smaller than other, zero if equal, greater than zero if larger
+	int32 Compare(const FBabelNumber &other) const;
+	bool operator<(const FBabelNumber &other) const { return Compare(other) < 0; }
+	bool operator==(const FBabelNumber &other) const { return Compare(other) == 0; }
+
+	// Bits needed to hold the value
+	int32 BitLength() const;
+
+	// this = this * factor + add. Returns what overflowed the top limb
+	uint32 MultiplyAdd(uint32 factor, uint32 add);
+
+	// this /= divisor. Returns the remainder
+	uint32 Divide(uint32 divisor) { return DivideBy(divisor); }
+
+	// Divide by a constant, which compiles to multiplies instead of divides
+	template <uint32 divisor>
+	uint32 Divide() { return DivideBy(divisor); }
+
+	// Wrapping addition and subtraction
+	void Add(const FBabelNumber &other);
+	void Subtract(const FBabelNumber &other);
+
+	// Clear bits from bits up
+	void Mask(int32 bits);
+
+	// this ^= this >> shift
+	void XorShiftRight(int32 shift);
+
+	// Low half of a * b
+	static FBabelNumber MultiplyLow(const FBabelNumber &a, const FBabelNumber &b);
+
+	// Inverse of an odd number modulo 2^bitCount (and so modulo any smaller power of two), by Newton iteration
+	static FBabelNumber InverseOdd(const FBabelNumber &a);
+
+private:
+	FORCEINLINE uint32 DivideBy(uint32 divisor)
+	{
+		// Leading zero limbs stay zero, repeated division shrinks the number so skipping them adds up
+		int32 top = limbCount - 1;
+		while (top > 0 && limbs[top] == 0)
+			top--;
+
+		uint64 remainder = 0;
+		for (int32 i = top; i >= 0; i--)
+		{
+			uint64 value = remainder << 32 | limbs[i];
+			limbs[i] = uint32(value / divisor);
+			remainder = value % divisor;
+		}
+		return uint32(remainder);
+	}
+};
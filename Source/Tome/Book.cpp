@@ -1,12 +1,18 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "Book.h"
+#include "BookText.h"
+#include "TomeStats.h"
+#include "Async/Async.h"
 
 // Sets default values
 ABook::ABook()
 {
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = false;
+	PrimaryActorTick.bCanEverTick = true;
+
+	// Only ticks to collect prefetched pages
+	PrimaryActorTick.bStartWithTickEnabled = false;
 
 	SceneRoot = CreateDefaultSubobject<USceneComponent>("SceneRoot");
 	RootComponent = SceneRoot;
@@ -15,11 +21,13 @@ ABook::ABook()
 	FrontText = CreateDefaultSubobject<UTextRenderComponent>("FrontText");
 	FrontPageNum = CreateDefaultSubobject<UTextRenderComponent>("FrontPageNum");
 	FrontSpineText = CreateDefaultSubobject<UTextRenderComponent>("FrontSpineText");
+	FrontPageGlyphs = CreateDefaultSubobject<UGlyphTextComponent>("FrontPageGlyphs");
 
 	BackMesh = CreateDefaultSubobject<UStaticMeshComponent>("BackCover");
 	BackText = CreateDefaultSubobject<UTextRenderComponent>("BackText");
 	BackPageNum = CreateDefaultSubobject<UTextRenderComponent>("BackPageNum");
 	BackSpineText = CreateDefaultSubobject<UTextRenderComponent>("BackSpineText");
+	BackPageGlyphs = CreateDefaultSubobject<UGlyphTextComponent>("BackPageGlyphs");
 
 	CoverText = CreateDefaultSubobject<UTextRenderComponent>("CoverText");
 
@@ -27,11 +35,13 @@ ABook::ABook()
 	FrontText->SetupAttachment(FrontMesh);
 	FrontPageNum->SetupAttachment(FrontMesh);
 	FrontSpineText->SetupAttachment(FrontMesh);
+	FrontPageGlyphs->SetupAttachment(FrontMesh);
 
 	BackMesh->SetupAttachment(SceneRoot);
 	BackText->SetupAttachment(BackMesh);
 	BackPageNum->SetupAttachment(BackMesh);
 	BackSpineText->SetupAttachment(BackMesh);
+	BackPageGlyphs->SetupAttachment(BackMesh);
 
 	CoverText->SetupAttachment(FrontMesh);
 }
@@ -40,66 +50,154 @@ ABook::ABook()
 void ABook::BeginPlay()
 {
 	Super::BeginPlay();
+
+	FTomeStats::books++;
+
+	// Glyph grids are the size of a page
+	FrontPageGlyphs->SetGridSize(pageLineLength, pageLineCount);
+	BackPageGlyphs->SetGridSize(pageLineLength, pageLineCount);
+
+	// Only one way of drawing pages is visible
+	bool glyphs = UsePageGlyphs();
+	FrontText->SetVisibility(!glyphs);
+	BackText->SetVisibility(!glyphs);
+	FrontPageGlyphs->SetVisibility(glyphs);
+	BackPageGlyphs->SetVisibility(glyphs);
 }
 
-char ABook::GetRandomCharacter(bool punctuation)
+// Called when the game ends or when destroyed
+void ABook::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	char possibleCharacters[] = "abcdefghijklmnopqrstuvwxyz .,";
+	CancelPrefetch();
 
-	int32 range = sizeof(possibleCharacters) / sizeof(possibleCharacters[0]) - 2; // -1 for inclusive, -1 for null
+	FTomeStats::books--;
+	FTomeStats::cachedPageBytes -= pages_.GetUsedBytes();
+	pages_.Empty();
 
-    // Last two are punctuation
-	if (!punctuation)
-		range -= 2;
+	Super::EndPlay(EndPlayReason);
+}
 
-    // Return random from remaining
-	return possibleCharacters[stream.RandRange(0, range)];
+FString ABook::GetPage(int32 page)
+{
+	FString text;
+	if (GetPackedPage(page) != nullptr)
+		pages_.Expand(page, pageLineLength, text);
+	return text;
 }
 
-const FString &ABook::GetPage(int32 page)
+const FPackedPage *ABook::GetPackedPage(int32 page)
 {
-	static FString empty = "";
+	TOME_SCOPE(GetPage);
 
     // Out of bounds
 	if (page < 1 || page > pageCount)
-		return empty;
+		return nullptr;
 
-    // Number of characters to generate
-	float characters = pageLineLength * pageLineCount;
+	ApplyPrefetchedPages();
 
-	// Last page could have less characters
-	if (page == pageCount)
-		characters = stream.RandRange(1, characters);
+    // Generate the page if doesn't exist, same text whatever was opened before
+	if (!pages_.Contains(page))
+	{
+		int32 usedBytes = pages_.GetUsedBytes();
+		int32 length = FBookText::PageLength(bookSeed, page, pageCount, pageLineLength, pageLineCount);
+		pages_.Add(page, FBookText::MakeKey(bookSeed, FBookText::KEY_PAGE, page), length, maxPageBytes);
+		FTomeStats::cachedPageBytes += pages_.GetUsedBytes() - usedBytes;
+	}
 
-    // Generate the page if doesn't exist
-	if (!pageContents.Contains(page))
-		pageContents.Add(page, GenerateText(characters, pageLineLength));
+	return pages_.Find(page);
+}
 
-	return pageContents[page];
+void ABook::DisplayPageGlyphs(UGlyphTextComponent *glyphs, int32 page)
+{
+	const FPackedPage *packed = GetPackedPage(page);
+	if (packed != nullptr)
+		glyphs->SetPackedText(packed->words.GetData(), packed->length);
+	else
+		glyphs->ClearGlyphText();
 }
 
-FString ABook::GetPageNumber(int32 page)
+bool ABook::UsePageGlyphs() const
 {
-	if (page < 1 || page > pageCount)
-		return "";
-	
-	return FString::FromInt(page);
+	return FrontPageGlyphs->IsReady() && BackPageGlyphs->IsReady();
 }
 
-FString ABook::GenerateText(int32 length, int32 lineSize, bool punctuation)
+void ABook::PrefetchPages(int32 page)
 {
-	FString result;
+	if (prefetchSpreads <= 0)
+		return;
 
-	for (int32 i = 0; i < length; i++)
+	// Keep what the last task finished
+	ApplyPrefetchedPages();
+
+	// Nearest spreads first, forward before back
+	TSharedPtr<FPagePrefetchBatch, ESPMode::ThreadSafe> batch = MakeShared<FPagePrefetchBatch, ESPMode::ThreadSafe>();
+	for (int32 spread = 1; spread <= prefetchSpreads; spread++)
 	{
-		result += GetRandomCharacter(punctuation);
+		for (int32 first : { page + spread * 2, page - spread * 2 })
+		{
+			for (int32 prefetch = first; prefetch <= first + 1; prefetch++)
+			{
+				if (prefetch < 1 || prefetch > pageCount || pages_.Contains(prefetch))
+					continue;
 
-        // Newlines after every lineSize
-		if (lineSize != 0 && (i + 1) % lineSize == 0)
-			result += '\n';
+				int32 length = FBookText::PageLength(bookSeed, prefetch, pageCount, pageLineLength, pageLineCount);
+				batch->pages.Add({ prefetch, FBookText::MakeKey(bookSeed, FBookText::KEY_PAGE, prefetch), length });
+			}
+		}
 	}
 
-	return result;
+	CancelPrefetch();
+	if (batch->pages.Num() == 0)
+		return;
+
+	prefetch_ = batch;
+	SetActorTickEnabled(true);
+
+	Async(EAsyncExecution::ThreadPool, [batch]()
+	{
+		for (const FPagePrefetch &prefetch : batch->pages)
+		{
+			if (batch->cancelled)
+				break;
+
+			FPackedPage page;
+			page.Generate(prefetch.page, prefetch.key, prefetch.length);
+			batch->results.Enqueue(MoveTemp(page));
+		}
+		batch->done = true;
+	});
+}
+
+void ABook::ApplyPrefetchedPages()
+{
+	if (!prefetch_.IsValid())
+		return;
+
+	int32 usedBytes = pages_.GetUsedBytes();
+	FPackedPage page;
+	while (prefetch_->results.Dequeue(page))
+		pages_.Add(MoveTemp(page), maxPageBytes);
+	FTomeStats::cachedPageBytes += pages_.GetUsedBytes() - usedBytes;
+
+	// Finished and everything stored
+	if (prefetch_->done && prefetch_->results.IsEmpty())
+		prefetch_.Reset();
+}
+
+void ABook::CancelPrefetch()
+{
+	// The task only touches the batch so it doesn't need to be waited on
+	if (prefetch_.IsValid())
+		prefetch_->cancelled = true;
+	prefetch_.Reset();
+}
+
+FString ABook::GetPageNumber(int32 page)
+{
+	if (page < 1 || page > pageCount)
+		return "";
+	
+	return FString::FromInt(page);
 }
 
 void ABook::WrapString(FString &string, int32 lineLength)
@@ -206,28 +304,51 @@ void ABook::RemoveSequentialString(FString &string, TCHAR character)
 void ABook::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
+
+	ApplyPrefetchedPages();
+	if (!prefetch_.IsValid())
+		SetActorTickEnabled(false);
 }
 
 void ABook::SetSeed(int32 seed)
 {
+	if (seed != bookSeed)
+	{
+		// Pages of the old seed
+		CancelPrefetch();
+		FTomeStats::cachedPageBytes -= pages_.GetUsedBytes();
+		pages_.Empty();
+	}
+
+	bookSeed = seed;
 	stream.Initialize(seed);
 }
 
 void ABook::GenerateOuterText()
 {
+	TOME_SCOPE(GenerateOuterText);
+
     // Generate title
-	FString outerContent = GenerateText(stream.RandRange(1, coverMaxLength), 0, false);
-	outerContent.TrimStartAndEndInline();
-	RemoveSequentialString(outerContent, ' ');
-	TitleCase(outerContent);
+	FString spine;
+	FString cover;
+	FBookText::FormatTitle(bookSeed, coverMaxLength, coverLineLength, spine, cover);
+	SetOuterText(MoveTemp(spine), MoveTemp(cover));
+}
 
+void ABook::SetOuterText(FString spine, FString cover)
+{
     // Spine title
-	FrontSpineText->SetText(FText::FromString(outerContent));
-	BackSpineText->SetText(FText::FromString(outerContent));
+	FText spineText = FText::FromString(MoveTemp(spine));
+	FrontSpineText->SetText(spineText);
+	BackSpineText->SetText(spineText);
 
     // Front title
-	WrapString(outerContent, coverLineLength);
-	CoverText->SetText(FText::FromString(outerContent));
+	CoverText->SetText(FText::FromString(MoveTemp(cover)));
+}
+
+FString ABook::GenerateSpineTitle(int32 seed, int32 maxLength)
+{
+	return FBookText::FormatSpine(seed, maxLength);
 }
 
 void ABook::DisplayPage(int32 page, USoundBase *sound)
@@ -239,14 +360,24 @@ void ABook::DisplayPage(int32 page, USoundBase *sound)
 	if (sound != nullptr)
 		UGameplayStatics::PlaySoundAtLocation(GetWorld(), sound, GetActorLocation());
 
-    // Set page text
-	FrontText->SetText(FText::FromString(GetPage(page)));
-	BackText->SetText(FText::FromString(GetPage(page + 1)));
+    // Set page text, glyphs just take the packed symbols
+	if (UsePageGlyphs())
+	{
+		DisplayPageGlyphs(FrontPageGlyphs, page);
+		DisplayPageGlyphs(BackPageGlyphs, page + 1);
+	}
+	else
+	{
+		FrontText->SetText(FText::FromString(GetPage(page)));
+		BackText->SetText(FText::FromString(GetPage(page + 1)));
+	}
 
     // Set page numbers
 	FrontPageNum->SetText(FText::FromString(GetPageNumber(page)));
 	BackPageNum->SetText(FText::FromString(GetPageNumber(page + 1)));
 
 	currentPage = page;
+
+	PrefetchPages(page);
 }
 
@@ -7,6 +7,8 @@
 #include "Components/TextRenderComponent.h"
 #include "Components/StaticMeshComponent.h"
 #include "Kismet/GameplayStatics.h" 
+#include "PageStore.h"
+#include "GlyphTextComponent.h"
 #include "Book.generated.h"
 
 UCLASS()
@@ -29,10 +31,31 @@ public:
 	UFUNCTION(BlueprintCallable)
 	void GenerateOuterText();
 
+	// Show a spine and cover title formatted elsewhere (see FBookTitleBatch)
+	void SetOuterText(FString spine, FString cover);
+
+	// Spine text of a book with a seed, what GenerateOuterText shows on the spine
+	static FString GenerateSpineTitle(int32 seed, int32 maxLength);
+
+	// String helpers titles were formatted with before FBookText::FormatTitle, the baseline of the Titles benchmark
+
+    // Insert newlines so string fits width
+	static void WrapString(FString &string, int32 lineLength);
+
+    // Convert string to first letters capitalized
+	static void TitleCase(FString &string);
+
+    // Remove repeated characters in string
+	static void RemoveSequentialString(FString &string, TCHAR character);
+
 	// Displays page given on left and page after on right. Generates first if needed
 	UFUNCTION(BlueprintCallable)
 	void DisplayPage(int32 page, USoundBase *sound = nullptr);
 
+	// Generate pages around a spread on a worker thread, so turning to them doesn't have to
+	UFUNCTION(BlueprintCallable)
+	void PrefetchPages(int32 page);
+
     // Event for blueprint to enable physics
 	UFUNCTION(BlueprintImplementableEvent)
 	void EnablePhysics(bool enable);
@@ -45,33 +68,36 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
-private:
-    // Returns a random character
-	char GetRandomCharacter(bool punctuation = true);
+	// Called when the game ends or when destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
+private:
     // Get content on a page (generate if doesn't exist)
-	const FString &GetPage(int32 page);
+	FString GetPage(int32 page);
 
-    // Get the page number as a string
-	FString GetPageNumber(int32 page);
+	// Get a page packed (generate if doesn't exist), null if out of bounds
+	const FPackedPage *GetPackedPage(int32 page);
 
-    // Generate text for a page
-	FString GenerateText(int32 length, int32 lineSize = 0, bool punctuation = true);
+	// Show a page with glyphs, blank if out of bounds
+	void DisplayPageGlyphs(UGlyphTextComponent *glyphs, int32 page);
 
-    // Insert newlines so string fits width
-	void WrapString(FString &string, int32 lineLength);
+	// Whether pages are drawn with glyph components rather than text render components
+	bool UsePageGlyphs() const;
 
-    // Convert string to first letters capitalized
-	void TitleCase(FString &string);
+	// Store pages finished by the prefetch task
+	void ApplyPrefetchedPages();
+
+	// Stop the prefetch task, dropping anything it hasn't stored
+	void CancelPrefetch();
+
+    // Get the page number as a string
+	FString GetPageNumber(int32 page);
 
     // Convert char to uppercase
-	char ToUpper(char c);
+	static char ToUpper(char c);
 
     // Divide string into array of strings given delimiter
-	TArray<FString> DivideString(FString string, const FString &delimiter);
-
-    // Remove repeated characters in string
-	void RemoveSequentialString(FString &string, TCHAR character);
+	static TArray<FString> DivideString(FString string, const FString &delimiter);
 
 public:
 	
@@ -80,11 +106,21 @@ public:
 
 	// Generation
 
+	// Seed all text is generated from (see FBookText)
 	UPROPERTY(BlueprintReadOnly)
-	FRandomStream stream;
+	int32 bookSeed = 0;
 
+	// Random stream seeded with bookSeed, for blueprints (text doesn't use it)
 	UPROPERTY(BlueprintReadOnly)
-	TMap<int32, FString> pageContents;
+	FRandomStream stream;
+
+	// Most memory generated pages can hold, oldest pages are dropped past this (0 for no limit)
+	UPROPERTY(BlueprintReadWrite)
+	int32 maxPageBytes = 0;
+
+	// Spreads either side of the displayed one generated in the background after DisplayPage (0 for none)
+	UPROPERTY(BlueprintReadWrite)
+	int32 prefetchSpreads = 1;
 	
 	UPROPERTY(BlueprintReadWrite)
 	int32 pageLineCount = 15;
@@ -121,6 +157,10 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
 	UTextRenderComponent *FrontSpineText;
 
+	// Used instead of FrontText when it has a glyph material
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	UGlyphTextComponent *FrontPageGlyphs;
+
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
 	UStaticMeshComponent *BackMesh;
@@ -134,7 +174,18 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
 	UTextRenderComponent *BackSpineText;
 
+	// Used instead of BackText when it has a glyph material
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	UGlyphTextComponent *BackPageGlyphs;
+
 	
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
 	UTextRenderComponent *CoverText;
+
+private:
+	// Pages generated so far, packed until displayed
+	FPageStore pages_;
+
+	// Pages being generated in the background, ticks while set
+	TSharedPtr<FPagePrefetchBatch, ESPMode::ThreadSafe> prefetch_;
 };
@@ -18,6 +18,11 @@ void ABookPool::BeginPlay()
 	
 }
 
+void ABookPool::ReturnBook_Implementation(ABook *book)
+{
+	book->Destroy();
+}
+
 // Called every frame
 void ABookPool::Tick(float DeltaTime)
 {
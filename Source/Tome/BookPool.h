@@ -20,6 +20,10 @@ public:
 	UFUNCTION(BlueprintImplementableEvent)
 	ABook *GetBook();
 
+    // Give a book back to the pool once nothing uses it, destroys it unless overridden
+	UFUNCTION(BlueprintNativeEvent)
+	void ReturnBook(ABook *book);
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
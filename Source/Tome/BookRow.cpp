@@ -3,12 +3,23 @@
 #define EPSILON 0.001f
 
 #include "BookRow.h"
+#include "EngineUtils.h"
+#include "LibraryGenerator.h"
+#include "GlyphTextComponent.h"
+#include "TomeStats.h"
+#include "TimerManager.h"
+#include "Async/Async.h"
+#include "Engine/Texture2D.h"
+#include "Materials/MaterialInstanceDynamic.h"
 
 // Sets default values
 ABookRow::ABookRow()
 {
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = false;
+	PrimaryActorTick.bCanEverTick = true;
+
+	// Only ticks to collect generated titles
+	PrimaryActorTick.bStartWithTickEnabled = false;
 }
 
 bool ABookRow::AddBook(ABook *book, FVector worldPos, FVector &outPos, bool enforceMaxDist)
@@ -80,12 +91,22 @@ bool ABookRow::AddBookLocal(ABook *book, float localPosY, FVector &outPos, bool
 	}
 
 	outPos = AddBookRaw(book, index, position);
+
+	// Whoever placed the book moves it to outPos first
+	if (CanInstanceBooks())
+		GetWorldTimerManager().SetTimerForNextTick(FTimerDelegate::CreateUObject(this, &ABookRow::DemoteShelvedBook, TWeakObjectPtr<ABook>(book)));
+
 	return true;
 }
 
 void ABookRow::RemoveBook(ABook *book)
 {
-	books.Remove(book);
+	int32 index = FindBook(book);
+	if (index != INDEX_NONE)
+	{
+		books.RemoveAt(index);
+		FTomeStats::shelvedBooks--;
+	}
 }
 
 void ABookRow::GenerateBooksSimple(int32 count, ABookPool *bookPool)
@@ -121,6 +142,51 @@ void ABookRow::GenerateBooksSimple(int32 count, ABookPool *bookPool)
 }
 
 void ABookRow::GenerateBooks(ABookPool *bookPool)
+{
+	TOME_SCOPE(GenerateBooks);
+
+	BeginGenerateBooks(bookPool);
+
+    // Let a generator spread the groups over frames
+	for (TActorIterator<ALibraryGenerator> generator(GetWorld()); generator; ++generator)
+	{
+		if (generator->budgetShelfGeneration)
+		{
+			generator->QueueShelf(this);
+			return;
+		}
+	}
+
+	while (GenerateBooksStep());
+}
+
+void ABookRow::BeginGenerateBooks(ABookPool *bookPool)
+{
+	generationPool = bookPool;
+	generationStage = 0;
+
+	// Seeded here rather than in BeginPlay, blueprints generate from theirs before ours runs. Rows starting the
+	// same frame still get different books
+	seedRandom_.Initialize(int32(FBookText::Random(FPlatformTime::Cycles64(), GetUniqueID())));
+
+    // Find border offsets
+	generationLeft = -width / 2.0f;
+	generationRight = width / 2.0f;
+}
+
+bool ABookRow::GenerateBooksStep()
+{
+	TOME_SCOPE(GenerateBooksStep);
+
+	// Titles of the whole row at once, when its books are all placed
+	if (AddNextGroup())
+		return true;
+
+	GenerateTitles();
+	return false;
+}
+
+bool ABookRow::AddNextGroup()
 {
     // Configurable variables
 
@@ -139,30 +205,33 @@ void ABookRow::GenerateBooks(ABookPool *bookPool)
 
 	float endGroupChance = 0.8f;
 
-    // Find border offsets
-	float leftBorder = -width / 2.0f;
-	float rightBorder = width / 2.0f;
+	ABookPool *bookPool = generationPool;
+	float &leftBorder = generationLeft;
+	float &rightBorder = generationRight;
 
-    // Generate group on left wall
-	if (FMath::FRand() < endGroupChance)
-		leftBorder = AddGroup(leftBorder, FMath::RandRange(groupSizeMin, groupSizeMax), rightBorder, true, bookPool);
+	switch (generationStage++)
+	{
+	case 0:
+        // Generate group on left wall
+		if (FMath::FRand() < endGroupChance)
+			leftBorder = AddGroup(leftBorder, FMath::RandRange(groupSizeMin, groupSizeMax), rightBorder, true, bookPool);
+		return true;
 
-    // Generate group on right wall
-	if (FMath::FRand() < endGroupChance)
-		rightBorder = AddGroup(rightBorder, FMath::RandRange(groupSizeMin, groupSizeMax), leftBorder, false, bookPool);
+	case 1:
+        // Generate group on right wall
+		if (FMath::FRand() < endGroupChance)
+			rightBorder = AddGroup(rightBorder, FMath::RandRange(groupSizeMin, groupSizeMax), leftBorder, false, bookPool);
 
-    // If already full, stop
-	if (rightBorder == FP_NAN)
-		return;
+        // If already full, stop
+		return rightBorder != FP_NAN;
 
-	while (true)
-	{
+	default:
         // Add space between groups
 		leftBorder += FMath::RandRange(spaceBetweenMin, spaceBetweenMax);
 
         // If full, stop
 		if (leftBorder >= rightBorder)
-			break;
+			return false;
 
         // Generate right leaning book
 		if (FMath::FRand() < leaningBookChance && leftBorder + leaningBookSize < rightBorder)
@@ -188,7 +257,7 @@ void ABookRow::GenerateBooks(ABookPool *bookPool)
 
         // If full, stop
 		if (leftBorder == FP_NAN)
-			break;
+			return false;
 
         // Generate left leaning book
 		if (FMath::FRand() < leaningBookChance && leftBorder + leaningBookSize < rightBorder)
@@ -199,7 +268,158 @@ void ABookRow::GenerateBooks(ABookPool *bookPool)
 			book->PhysicsTeleport(FVector(0.0f, leftBorder + leaningBookSize / 2.0f, 0.0f), FRotator(270.0f - leaningBookAngle, 270.0f, 90.0f));
 			leftBorder += leaningBookSize;
 		}
+		return true;
+	}
+}
+
+void ABookRow::GetBookSeeds(TArray<int32> &outSeeds) const
+{
+	outSeeds.Reset(books.Num());
+	for (const FShelvedBook &shelved : books)
+	{
+		if (shelved.actor == nullptr)
+			outSeeds.Add(shelved.seed);
+		else if (IsValid(shelved.actor))
+			outSeeds.Add(shelved.actor->bookSeed);
+	}
+}
+
+ABook *ABookRow::PromoteInstance(int32 instance)
+{
+	int32 index = books.IndexOfByPredicate([instance](const FShelvedBook &shelved)
+	{
+		return shelved.actor == nullptr && shelved.instance == instance;
+	});
+	if (index == INDEX_NONE)
+		return nullptr;
+
+	// Same book as the instance, text and all
+	ABook *book;
+	if (generationPool != nullptr)
+		book = generationPool->GetBook();
+	else
+		book = Cast<ABook>(GetWorld()->SpawnActor(bookType.Get()));
+	if (book == nullptr)
+		return nullptr;
+
+	FShelvedBook &shelved = books[index];
+	book->SetSeed(shelved.seed);
+	book->GenerateOuterText();
+	book->AttachToActor(this, { EAttachmentRule::KeepWorld, false });
+	book->SetActorRelativeLocation(FVector(0.0f, shelved.position, 0.0f));
+	book->SetActorRelativeRotation(FQuat::MakeFromEuler(FVector(0.0f, 270.0f, 0.0f)));
+
+	RemoveInstance(shelved);
+	shelved.actor = book;
+	FTomeStats::shelvedBooks++;
+
+	UploadTitles();
+	return book;
+}
+
+void ABookRow::DemoteBook(ABook *book)
+{
+	if (!CanInstanceBooks())
+		return;
+
+	// Only books still resting on the row
+	ValidateBookArray();
+	int32 index = FindBook(book);
+	if (index == INDEX_NONE)
+		return;
+
+	FShelvedBook &shelved = books[index];
+	shelved.position = GetPosition(index);
+	shelved.seed = book->bookSeed;
+	shelved.halfWidth = book->halfWidth;
+	shelved.actor = nullptr;
+	FTomeStats::shelvedBooks--;
+	AddInstance(shelved);
+
+	if (shelved.titleRow != INDEX_NONE)
+	{
+		FString spine = FBookText::FormatSpine(shelved.seed, titleColumns_);
+		SetTitle(shelved.titleRow, *spine, spine.Len());
+	}
+
+	book->DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+	if (generationPool != nullptr)
+		generationPool->ReturnBook(book);
+	else
+		book->Destroy();
+
+	UploadTitles();
+}
+
+void ABookRow::GenerateTitles()
+{
+	CancelTitles();
+
+	TSharedPtr<FBookTitleBatch, ESPMode::ThreadSafe> batch = MakeShared<FBookTitleBatch, ESPMode::ThreadSafe>();
+	GetBookSeeds(batch->seeds);
+	if (batch->seeds.Num() == 0)
+		return;
+
+	const ABook *book = GetDefaultBook();
+	batch->maxLength = FMath::Clamp(book->coverMaxLength, 1, FBookText::maxTitleLength);
+	batch->lineLength = book->coverLineLength;
+
+	titles_ = batch;
+	SetActorTickEnabled(true);
+
+	Async(EAsyncExecution::ThreadPool, [batch]()
+	{
+		batch->Format();
+	});
+}
+
+void ABookRow::ApplyTitles()
+{
+	if (!titles_.IsValid() || !titles_->done)
+		return;
+
+	TOME_SCOPE(ApplyTitles);
+
+	TSharedPtr<FBookTitleBatch, ESPMode::ThreadSafe> batch = titles_;
+	titles_.Reset();
+
+	// Books may have moved since the batch started, titles only depend on the seed
+	TMap<int32, int32> entries;
+	entries.Reserve(batch->seeds.Num());
+	for (int32 i = 0; i < batch->seeds.Num(); i++)
+		entries.Add(batch->seeds[i], i);
+
+	ValidateBookArray();
+	for (const FShelvedBook &shelved : books)
+	{
+		const int32 *entry = entries.Find(shelved.actor != nullptr ? shelved.actor->bookSeed : shelved.seed);
+		if (entry == nullptr)
+			continue;
+
+		if (shelved.actor != nullptr)
+		{
+			shelved.actor->SetOuterText(FString(batch->spineLengths[*entry], batch->GetSpine(*entry)),
+				FString(batch->coverLengths[*entry], batch->GetCover(*entry)));
+		}
+		else if (shelved.titleRow != INDEX_NONE)
+			SetTitle(shelved.titleRow, batch->GetSpine(*entry), batch->spineLengths[*entry]);
 	}
+
+	UploadTitles();
+}
+
+void ABookRow::CancelTitles()
+{
+	// The task only touches the batch so it doesn't need to be waited on
+	if (titles_.IsValid())
+		titles_->cancelled = true;
+	titles_.Reset();
+}
+
+void ABookRow::DemoteShelvedBook(TWeakObjectPtr<ABook> book)
+{
+	if (book.IsValid())
+		DemoteBook(book.Get());
 }
 
 // Called when the game starts or when spawned
@@ -209,6 +429,23 @@ void ABookRow::BeginPlay()
 	
 }
 
+// Called when the game ends or when destroyed
+void ABookRow::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	CancelTitles();
+
+	for (const FShelvedBook &shelved : books)
+	{
+		if (shelved.actor != nullptr)
+			FTomeStats::shelvedBooks--;
+		else
+			FTomeStats::instancedBooks--;
+	}
+	books.Reset();
+
+	Super::EndPlay(EndPlayReason);
+}
+
 void ABookRow::ValidateBookArray()
 {
 	TArray<AActor *> children;
@@ -216,10 +453,11 @@ void ABookRow::ValidateBookArray()
 
 	for (int i = 0; i < books.Num(); i++)
 	{
-        // Remove book if not a child
-		if (children.Find(books[i]) == INDEX_NONE)
+        // Remove book if not a child, instances always are
+		if (books[i].actor != nullptr && children.Find(books[i].actor) == INDEX_NONE)
 		{
 			books.RemoveAt(i);
+			FTomeStats::shelvedBooks--;
 			i--;
 		}
 	}
@@ -232,7 +470,7 @@ float ABookRow::GetBoundaryLeft(int32 indexBefore)
 	else if (indexBefore > books.Num())
 		return width / 2.0f;
 	else
-		return books[indexBefore - 1]->GetRootComponent()->GetRelativeLocation().Y + books[indexBefore - 1]->halfWidth;
+		return GetPosition(indexBefore - 1) + books[indexBefore - 1].halfWidth;
 }
 
 float ABookRow::GetBoundaryRight(int32 indexBefore)
@@ -242,12 +480,17 @@ float ABookRow::GetBoundaryRight(int32 indexBefore)
 	else if (indexBefore >= books.Num())
 		return width / 2.0f;
 	else
-		return books[indexBefore]->GetRootComponent()->GetRelativeLocation().Y - books[indexBefore]->halfWidth;
+		return GetPosition(indexBefore) - books[indexBefore].halfWidth;
 }
 
 FVector ABookRow::AddBookRaw(ABook *book, int32 index, float position)
 {
-	books.Insert(book, index);
+	FShelvedBook shelved;
+	shelved.actor = book;
+	shelved.seed = book->bookSeed;
+	shelved.halfWidth = book->halfWidth;
+	books.Insert(shelved, index);
+	FTomeStats::shelvedBooks++;
 	book->AttachToActor(this, { EAttachmentRule::KeepWorld, false });
 	return FVector(0.0f, position, 0.0f);
 }
@@ -258,7 +501,7 @@ int32 ABookRow::GetIndex(float position)
 	for (index = 0; index < books.Num(); index++)
 	{
         // Return first book that is passed position given
-		if (books[index]->GetRootComponent()->GetRelativeLocation().Y > position)
+		if (GetPosition(index) > position)
 			break;
 	}
 	return index;
@@ -268,18 +511,29 @@ float ABookRow::AddGroup(float position, int32 count, float border, bool goingRi
 {
 	int32 dir = goingRight ? 1 : -1;
 	int32 index = -1;
+	bool instanced = CanInstanceBooks();
 
 	for (int32 i = 0; i < count; i++)
 	{
-        // Create book
-		ABook *book = bookPool->GetBook();
-		position += book->halfWidth * dir;
+        // Create book, instances only need a seed until they are looked at
+		ABook *book = nullptr;
+		float halfWidth;
+		if (instanced)
+			halfWidth = GetDefaultBook()->halfWidth;
+		else
+		{
+			book = bookPool->GetBook();
+			halfWidth = book->halfWidth;
+		}
+		position += halfWidth * dir;
 
         // If passed border, delete this book
-		if (goingRight && position + book->halfWidth > border ||
-			!goingRight && position - book->halfWidth < border)
+		if (goingRight && position + halfWidth > border ||
+			!goingRight && position - halfWidth < border)
 		{
-			book->Destroy();
+			if (book != nullptr)
+				book->Destroy();
+			UploadTitles();
 			return FP_NAN;
 		}
 
@@ -290,21 +544,170 @@ float ABookRow::AddGroup(float position, int32 count, float border, bool goingRi
 			index++;
 
         // Set book position
-		FVector pos = AddBookRaw(book, index, position);
-		book->SetActorRelativeLocation(pos);
-		book->SetActorRelativeRotation(FQuat::MakeFromEuler(FVector(0.0f, 270.0f, 0.0f)));
+		if (book != nullptr)
+		{
+			FVector pos = AddBookRaw(book, index, position);
+			book->SetActorRelativeLocation(pos);
+			book->SetActorRelativeRotation(FQuat::MakeFromEuler(FVector(0.0f, 270.0f, 0.0f)));
+		}
+		else
+		{
+			FShelvedBook shelved;
+			shelved.seed = int32(seedRandom_.GetUnsignedInt());
+			shelved.position = position;
+			shelved.halfWidth = halfWidth;
+			AddInstance(shelved);
+			books.Insert(shelved, index);
+		}
 
-		position += book->halfWidth * dir;
+		position += halfWidth * dir;
 	}
 
+	UploadTitles();
 	return position;
 }
 
+float ABookRow::GetPosition(int32 index) const
+{
+	const FShelvedBook &shelved = books[index];
+	if (shelved.actor != nullptr)
+		return shelved.actor->GetRootComponent()->GetRelativeLocation().Y;
+	return shelved.position;
+}
+
+int32 ABookRow::FindBook(ABook *book) const
+{
+	if (book == nullptr)
+		return INDEX_NONE;
+
+	return books.IndexOfByPredicate([book](const FShelvedBook &shelved) { return shelved.actor == book; });
+}
+
+bool ABookRow::CanInstanceBooks() const
+{
+	return instancedBooks && bookInstanceMesh != nullptr && GetDefaultBook()->halfWidth > 0.0f;
+}
+
+const ABook *ABookRow::GetDefaultBook() const
+{
+	if (bookType.Get() != nullptr)
+		return bookType->GetDefaultObject<ABook>();
+	return GetDefault<ABook>();
+}
+
+void ABookRow::AddInstance(FShelvedBook &shelved)
+{
+	// One component draws every instanced book on the row
+	if (BookInstances == nullptr)
+	{
+		BookInstances = NewObject<UInstancedStaticMeshComponent>(this, TEXT("BookInstances"));
+		BookInstances->SetStaticMesh(bookInstanceMesh);
+		if (RootComponent != nullptr)
+			BookInstances->SetupAttachment(RootComponent);
+		else
+			SetRootComponent(BookInstances);
+
+		BookInstances->NumCustomDataFloats = 1;
+		if (bookInstanceMaterial != nullptr)
+		{
+			titleMaterial_ = UMaterialInstanceDynamic::Create(bookInstanceMaterial, this);
+			BookInstances->SetMaterial(0, titleMaterial_);
+		}
+		BookInstances->RegisterComponent();
+	}
+
+	FTransform transform(FQuat::MakeFromEuler(FVector(0.0f, 270.0f, 0.0f)), FVector(0.0f, shelved.position, 0.0f));
+	shelved.instance = BookInstances->AddInstance(transform);
+	FTomeStats::instancedBooks++;
+
+	shelved.titleRow = AddTitleRow();
+	BookInstances->SetCustomDataValue(shelved.instance, 0, float(shelved.titleRow), true);
+}
+
+void ABookRow::RemoveInstance(FShelvedBook &shelved)
+{
+	BookInstances->RemoveInstance(shelved.instance);
+	FTomeStats::instancedBooks--;
+
+	// Instances after the removed one move down to fill the gap
+	for (FShelvedBook &other : books)
+	{
+		if (other.actor == nullptr && other.instance > shelved.instance)
+			other.instance--;
+	}
+	shelved.instance = INDEX_NONE;
+
+	if (shelved.titleRow != INDEX_NONE)
+	{
+		RemoveTitleRow(shelved.titleRow);
+		shelved.titleRow = INDEX_NONE;
+	}
+}
+
+int32 ABookRow::AddTitleRow()
+{
+	if (titleColumns_ == 0)
+		titleColumns_ = FMath::Clamp(GetDefaultBook()->coverMaxLength, 1, FBookText::maxTitleLength);
+
+	int32 row;
+	if (freeTitleRows_.Num() > 0)
+		row = freeTitleRows_.Pop(false);
+	else
+	{
+		row = titleRows_++;
+
+		// Grow by doubling, the texture is remade on upload
+		int32 capacity = titleGlyphs_.Num() / titleColumns_;
+		if (row >= capacity)
+			titleGlyphs_.SetNumUninitialized(FMath::Max(capacity * 2, 16) * titleColumns_);
+	}
+
+	// Blank until its title is set, reused rows still hold the last one
+	FMemory::Memset(titleGlyphs_.GetData() + row * titleColumns_, UGlyphTextComponent::GLYPH_BLANK, titleColumns_);
+	titlesDirty_ = true;
+	return row;
+}
+
+void ABookRow::RemoveTitleRow(int32 row)
+{
+	// Nothing draws the row until it is reused
+	freeTitleRows_.Add(row);
+}
+
+void ABookRow::SetTitle(int32 row, const TCHAR *spine, int32 length)
+{
+	uint8 *glyphs = titleGlyphs_.GetData() + row * titleColumns_;
+	for (int32 i = 0; i < titleColumns_; i++)
+		glyphs[i] = i < length ? UGlyphTextComponent::GlyphIndex(spine[i]) : UGlyphTextComponent::GLYPH_BLANK;
+
+	titlesDirty_ = true;
+}
+
+void ABookRow::UploadTitles()
+{
+	if (!titlesDirty_ || titleMaterial_ == nullptr)
+		return;
+
+	int32 capacity = titleGlyphs_.Num() / titleColumns_;
+	if (titleTexture_ == nullptr || titleTexture_->GetSizeY() != capacity)
+	{
+		titleTexture_ = UGlyphTextComponent::CreateGlyphTexture(titleColumns_, capacity);
+		titleMaterial_->SetTextureParameterValue(TEXT("GlyphIndices"), titleTexture_);
+		titleMaterial_->SetVectorParameterValue(TEXT("GridSize"), FLinearColor(float(titleColumns_), float(capacity), 0.0f, 0.0f));
+	}
+
+	UGlyphTextComponent::UploadGlyphs(titleTexture_, titleGlyphs_, titleColumns_, capacity);
+	titlesDirty_ = false;
+}
+
 // Called every frame
 void ABookRow::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	ApplyTitles();
+	if (!titles_.IsValid())
+		SetActorTickEnabled(false);
 }
 
 void ABookRow::Destroyed()
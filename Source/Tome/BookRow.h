@@ -5,10 +5,26 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "Components/BoxComponent.h"
+#include "Components/InstancedStaticMeshComponent.h"
 #include "Book.h"
 #include "BookPool.h"
+#include "BookTitleBatch.h"
 #include "BookRow.generated.h"
 
+class UTexture2D;
+class UMaterialInstanceDynamic;
+
+// A book resting on a row, either an actor or an instance of the row's book mesh
+struct FShelvedBook
+{
+	ABook *actor = nullptr; // Null while drawn as an instance
+	int32 seed = 0;
+	float position = 0.0f; // Only kept for instances, actors have their own location
+	float halfWidth = 0.0f;
+	int32 instance = INDEX_NONE;
+	int32 titleRow = INDEX_NONE; // Row of the title atlas
+};
+
 UCLASS()
 class TOME_API ABookRow : public AActor
 {
@@ -40,14 +56,40 @@ public:
 	UFUNCTION(BlueprintCallable)
 	void GenerateBooksSimple(int32 count, ABookPool *bookPool = nullptr);
 
-    // Generate books in groups
+    // Generate books in groups (spread over frames if a library generator is scheduling shelves)
 	UFUNCTION(BlueprintCallable)
 	void GenerateBooks(ABookPool *bookPool = nullptr);
 
+    // Start generating books in groups, without adding any yet
+	void BeginGenerateBooks(ABookPool *bookPool);
+
+    // Add the next group of books. Returns whether there is more to add
+	bool GenerateBooksStep();
+
+	// Seeds of books on the row, for searching them (see FBookSearch)
+	void GetBookSeeds(TArray<int32> &outSeeds) const;
+
+	// Format the titles of every book on the row on a worker thread, shown on books and instances together once
+	// done. Called when GenerateBooksStep finishes
+	UFUNCTION(BlueprintCallable)
+	void GenerateTitles();
+
+	// Replace an instanced book with one from the pool, for when the player targets it.
+	// Returns null if no book is drawn by that instance of BookInstances
+	UFUNCTION(BlueprintCallable)
+	ABook *PromoteInstance(int32 instance);
+
+	// Give a book on the row back to the pool and draw it as an instance, if instancing books
+	UFUNCTION(BlueprintCallable)
+	void DemoteBook(ABook *book);
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	// Called when the game ends or when destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 private:
 	// Remove any books that aren't children
 	void ValidateBookArray();
@@ -62,9 +104,47 @@ private:
     // Get book at position
 	int32 GetIndex(float position);
 
+    // GenerateBooksStep before titles. Returns whether there is more to add
+	bool AddNextGroup();
+
     // Add a group of books to the shelf
 	float AddGroup(float position, int32 count, float border, bool goingRight = true, ABookPool *bookPool = nullptr);
 
+	// Local position of a book in the list
+	float GetPosition(int32 index) const;
+
+	// Index of a book in the list, INDEX_NONE if not on this row
+	int32 FindBook(ABook *book) const;
+
+	// Whether generated books can be instances
+	bool CanInstanceBooks() const;
+
+	// Defaults of the books the row holds
+	const ABook *GetDefaultBook() const;
+
+	// Draw a book as an instance, or stop
+	void AddInstance(FShelvedBook &shelved);
+	void RemoveInstance(FShelvedBook &shelved);
+
+	// Demote a book placed by AddBook once whoever placed it is done moving it
+	void DemoteShelvedBook(TWeakObjectPtr<ABook> book);
+
+	// Show titles the batch task finished, ticks until then
+	void ApplyTitles();
+
+	// Stop the title task, its titles are never shown
+	void CancelTitles();
+
+	// Take a blank row of the title atlas, or give it back
+	int32 AddTitleRow();
+	void RemoveTitleRow(int32 row);
+
+	// Write a spine title into a row of the title atlas
+	void SetTitle(int32 row, const TCHAR *spine, int32 length);
+
+	// Send changed titles to the atlas texture
+	void UploadTitles();
+
 public:	
 	UPROPERTY(BlueprintReadOnly)
 	UBoxComponent *Collider;
@@ -78,6 +158,50 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
 	TSubclassOf<ABook> bookType;
 
+	// Draw generated upright books as instances of bookInstanceMesh until the player targets one.
+	// Needs bookType to have a halfWidth, ignored otherwise
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool instancedBooks = false;
+
+	// Mesh placed like a book actor's root
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	UStaticMesh *bookInstanceMesh = nullptr;
+
+	// Draws spines from the title atlas: texture parameter GlyphIndices, vector parameter GridSize (columns, rows)
+	// and the title row in per-instance custom data 0 (see UGlyphTextComponent)
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	UMaterialInterface *bookInstanceMaterial = nullptr;
+
+	// Created when the first book is instanced
+	UPROPERTY(BlueprintReadOnly)
+	UInstancedStaticMeshComponent *BookInstances = nullptr;
+
 private:
-	TArray<ABook *> books;
+	// Left to right
+	TArray<FShelvedBook> books;
+
+	// Seeds of instanced books
+	FRandomStream seedRandom_;
+
+	// Titles being formatted in the background, ticks while set
+	TSharedPtr<FBookTitleBatch, ESPMode::ThreadSafe> titles_;
+
+	// Spine titles of instanced books, one row of glyphs each
+	UPROPERTY(Transient)
+	UTexture2D *titleTexture_ = nullptr;
+
+	UPROPERTY(Transient)
+	UMaterialInstanceDynamic *titleMaterial_ = nullptr;
+
+	TArray<uint8> titleGlyphs_;
+	TArray<int32> freeTitleRows_;
+	int32 titleColumns_ = 0;
+	int32 titleRows_ = 0;
+	bool titlesDirty_ = false;
+
+    // State of GenerateBooksStep
+	ABookPool *generationPool = nullptr;
+	float generationLeft = 0.0f;
+	float generationRight = 0.0f;
+	int32 generationStage = 0;
 };
@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BookSearch.h"
+#include "Async/Async.h"
+#include "BookText.h"
+
+// Bytes read past the end of a page by the scan
+static const int32 scanPadding = sizeof(uint64) + 1;
+
+static const uint64 lowBytes = 0x0101010101010101ull;
+static const uint64 highBits = 0x8080808080808080ull;
+
+TSharedRef<FBookSearch, ESPMode::ThreadSafe> FBookSearch::Start(const TArray<FString> &queries, const TArray<int32> &seeds, int32 pageCount, int32 lineLength, int32 lineCount, int32 workers)
+{
+	TSharedRef<FBookSearch, ESPMode::ThreadSafe> search = MakeShareable(new FBookSearch());
+	search->seeds_ = seeds;
+	search->pageCount_ = pageCount;
+	search->lineLength_ = lineLength;
+	search->lineCount_ = lineCount;
+
+	// Queries as symbols
+	for (const FString &query : queries)
+	{
+		TArray<uint8> symbols;
+		bool valid = true;
+		for (TCHAR c : query)
+		{
+			if (c == '\n' || c == '\r')
+				continue;
+
+			if (c >= 'A' && c <= 'Z')
+				c += 'a' - 'A';
+
+			const TCHAR *found = c != 0 ? FCString::Strchr(FBookText::alphabet, c) : nullptr;
+			if (found == nullptr)
+			{
+				valid = false;
+				break;
+			}
+			symbols.Add(uint8(found - FBookText::alphabet));
+		}
+
+		int32 index = search->queries_.Add(MoveTemp(symbols));
+		if (!valid || search->queries_[index].Num() == 0)
+		{
+			search->queries_[index].Reset();
+			continue;
+		}
+
+		const TArray<uint8> &added = search->queries_[index];
+		bool single = added.Num() == 1;
+		search->prefixes_.AddUnique({ lowBytes * added[0], single ? 0 : lowBytes * added[1], single });
+		search->queriesStarting_[added[0]].Add(index);
+	}
+
+	int32 workerCount = workers > 0 ? workers : FPlatformMisc::NumberOfWorkerThreadsToSpawn();
+	search->workerCount_ = FMath::Clamp(workerCount, 1, FMath::Max(seeds.Num(), 1));
+
+	if (search->prefixes_.Num() == 0 || seeds.Num() == 0 || pageCount <= 0)
+		return search;
+
+	search->runningWorkers_.Set(search->workerCount_);
+	for (int32 i = 0; i < search->workerCount_; i++)
+	{
+		Async(EAsyncExecution::ThreadPool, [search]()
+		{
+			search->Work();
+			search->runningWorkers_.Decrement();
+		});
+	}
+
+	return search;
+}
+
+void FBookSearch::Work()
+{
+	TArray<uint8> symbols;
+	symbols.SetNumZeroed(lineLength_ * lineCount_ + scanPadding);
+
+	while (!cancelled_)
+	{
+		int32 next = nextSeed_.Increment() - 1;
+		if (next >= seeds_.Num())
+			return;
+
+		int32 seed = seeds_[next];
+		for (int32 page = 1; page <= pageCount_ && !cancelled_; page++)
+		{
+			int32 length = FBookText::PageLength(seed, page, pageCount_, lineLength_, lineCount_);
+			FBookText::GenerateIndices(FBookText::MakeKey(seed, FBookText::KEY_PAGE, page), length, true, symbols.GetData());
+			ScanPage(symbols.GetData(), length, seed, page);
+			scannedSymbols_.Add(length);
+		}
+	}
+}
+
+void FBookSearch::ScanPage(const uint8 *symbols, int32 length, int32 seed, int32 page)
+{
+	for (int32 start = 0; start < length; start += sizeof(uint64))
+	{
+		// Symbols here and one along, so each byte lines up with the symbol after it
+		uint64 word;
+		uint64 next;
+		FMemory::Memcpy(&word, symbols + start, sizeof(uint64));
+		FMemory::Memcpy(&next, symbols + start + 1, sizeof(uint64));
+
+		// Bytes equal to the symbol become zero, then get their high bit set. Borrows can flag bytes above a real
+		// match too, the full compare below rules those out
+		uint64 candidates = 0;
+		for (const FPrefix &prefix : prefixes_)
+		{
+			uint64 difference = word ^ prefix.first;
+			uint64 matches = (difference - lowBytes) & ~difference & highBits;
+			if (!prefix.single)
+			{
+				difference = next ^ prefix.second;
+				matches &= (difference - lowBytes) & ~difference & highBits;
+			}
+			candidates |= matches;
+		}
+
+		for (; candidates != 0; candidates &= candidates - 1)
+		{
+			// Lowest byte is the first symbol, every target is little endian
+			int32 offset = start + int32(FPlatformMath::CountTrailingZeros64(candidates)) / 8;
+			if (offset >= length)
+				break;
+
+			for (int32 query : queriesStarting_[symbols[offset]])
+			{
+				const TArray<uint8> &pattern = queries_[query];
+				if (offset + pattern.Num() <= length && FMemory::Memcmp(symbols + offset, pattern.GetData(), pattern.Num()) == 0)
+					hits_.Enqueue({ seed, page, offset, query });
+			}
+		}
+	}
+}
@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "HAL/ThreadSafeBool.h"
+
+// Where a query was found
+struct FBookSearchHit
+{
+	int32 seed;
+	int32 page;
+	int32 offset; // Symbols into the page, newlines aren't counted
+	int32 query;  // Index into the queries searched for
+};
+
+// Searches the text of many books at once across worker threads. Pages are generated straight into symbol buffers
+// and scanned 8 symbols at a time for the first two symbols of every query, hits are queued as they are found
+class TOME_API FBookSearch : public TSharedFromThis<FBookSearch, ESPMode::ThreadSafe>
+{
+public:
+	// Start searching books with seeds for queries. Case and newlines in queries are ignored, queries with characters
+	// outside the alphabet never match. Pages are laid out as in ABook. workers is 0 for one per core
+	static TSharedRef<FBookSearch, ESPMode::ThreadSafe> Start(const TArray<FString> &queries, const TArray<int32> &seeds, int32 pageCount, int32 lineLength, int32 lineCount, int32 workers = 0);
+
+	// Take the next hit found, hits are in no particular order
+	bool NextHit(FBookSearchHit &outHit) { return hits_.Dequeue(outHit); }
+
+	// Stop searching, workers finish the page they are on
+	void Cancel() { cancelled_ = true; }
+
+	// Whether every worker has stopped, hits may still be queued
+	bool IsDone() const { return runningWorkers_.GetValue() == 0; }
+
+	// Symbols scanned so far
+	int64 GetScannedSymbols() const { return scannedSymbols_.GetValue(); }
+
+	int32 GetWorkerCount() const { return workerCount_; }
+
+private:
+	FBookSearch() = default;
+
+	// Search books until there are none left
+	void Work();
+
+	// Find queries in a page of symbols, which has padding after length
+	void ScanPage(const uint8 *symbols, int32 length, int32 seed, int32 page);
+
+	TArray<TArray<uint8>> queries_;
+
+	// Queries by their first symbol
+	TArray<int32> queriesStarting_[32];
+
+	// First two symbols of queries, each repeated in every byte
+	struct FPrefix
+	{
+		uint64 first;
+		uint64 second;
+		bool single; // One symbol query, second isn't checked
+
+		bool operator==(const FPrefix &other) const { return first == other.first && second == other.second && single == other.single; }
+	};
+	TArray<FPrefix> prefixes_;
+
+	TArray<int32> seeds_;
+	int32 pageCount_ = 0;
+	int32 lineLength_ = 0;
+	int32 lineCount_ = 0;
+	int32 workerCount_ = 0;
+
+	FThreadSafeCounter nextSeed_;
+	FThreadSafeCounter runningWorkers_;
+	FThreadSafeCounter64 scannedSymbols_;
+	FThreadSafeBool cancelled_;
+
+	TQueue<FBookSearchHit, EQueueMode::Mpsc> hits_;
+};
@@ -0,0 +1,364 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BookText.h"
+
+const TCHAR FBookText::alphabet[] = TEXT("abcdefghijklmnopqrstuvwxyz .,");
+
+// Six symbols are drawn from each 32 bits. Values past the last whole multiple of symbols^6 are skipped so every
+// symbol is equally likely. Symbol counts are constants so digits come out with multiplies rather than divides
+template <uint32 symbols>
+struct TSymbolGroups
+{
+	static const uint32 sixSymbols = symbols * symbols * symbols * symbols * symbols * symbols;
+	static const uint32 limit = uint32((uint64(MAX_uint32) + 1) / sixSymbols * sixSymbols - 1); // Largest accepted value
+
+	// Calls emit(value, written, count) for each run of six symbols (fewer at the end), which are the lowest count
+	// base symbols digits of value. Every way of generating text goes through here so they all give the same symbols
+	template <typename Emit>
+	static void ForEach(uint64 key, int32 length, Emit emit)
+	{
+		int32 written = 0;
+		uint64 counter = 0;
+		while (written < length)
+		{
+			uint64 bits = FBookText::Random(key, counter++);
+
+			for (uint32 half : { uint32(bits), uint32(bits >> 32) })
+			{
+				if (half > limit || written >= length)
+					continue;
+
+				int32 count = FMath::Min(6, length - written);
+				emit(half % sixSymbols, written, count);
+				written += count;
+			}
+		}
+	}
+};
+
+// Every pair of symbols as characters, indexed by first + second * symbols
+template <uint32 symbols>
+struct TSymbolPairs
+{
+	TSymbolPairs()
+	{
+		for (uint32 i = 0; i < symbols * symbols; i++)
+		{
+			pairs[i][0] = FBookText::alphabet[i % symbols];
+			pairs[i][1] = FBookText::alphabet[i / symbols];
+		}
+	}
+
+	static const TSymbolPairs &Get()
+	{
+		static const TSymbolPairs table;
+		return table;
+	}
+
+	TCHAR pairs[symbols * symbols][2];
+};
+
+template <uint32 symbols>
+static void GenerateSymbolsOf(uint64 key, int32 length, TCHAR *out)
+{
+	const TSymbolPairs<symbols> &table = TSymbolPairs<symbols>::Get();
+
+	TSymbolGroups<symbols>::ForEach(key, length, [&](uint32 value, int32 written, int32 count)
+	{
+		TCHAR *cursor = out + written;
+		if (count == 6)
+		{
+			// Base symbols^2 digits
+			for (int32 i = 0; i < 3; i++, cursor += 2)
+			{
+				FMemory::Memcpy(cursor, table.pairs[value % (symbols * symbols)], 2 * sizeof(TCHAR));
+				value /= symbols * symbols;
+			}
+			return;
+		}
+
+		// Tail of the text
+		for (int32 i = 0; i < count; i++)
+		{
+			*cursor++ = FBookText::alphabet[value % symbols];
+			value /= symbols;
+		}
+	});
+}
+
+template <uint32 symbols>
+static void GeneratePackedOf(uint64 key, int32 length, uint64 *out)
+{
+	// Six symbols fill half a word
+	TSymbolGroups<symbols>::ForEach(key, length, [&](uint32 value, int32 written, int32 count)
+	{
+		uint64 group = 0;
+		for (int32 i = 0; i < count; i++)
+		{
+			group |= uint64(value % symbols) << (i * FBookText::packedBits);
+			value /= symbols;
+		}
+		out[written / FBookText::symbolsPerWord] |= group << ((written % FBookText::symbolsPerWord) * FBookText::packedBits);
+	});
+}
+
+template <uint32 symbols>
+static void GenerateIndicesOf(uint64 key, int32 length, uint8 *out)
+{
+	// Every pair of indices, same layout as TSymbolPairs
+	struct FIndexPairs
+	{
+		FIndexPairs()
+		{
+			for (uint32 i = 0; i < symbols * symbols; i++)
+			{
+				pairs[i][0] = uint8(i % symbols);
+				pairs[i][1] = uint8(i / symbols);
+			}
+		}
+
+		uint8 pairs[symbols * symbols][2];
+	};
+	static const FIndexPairs table;
+
+	TSymbolGroups<symbols>::ForEach(key, length, [&](uint32 value, int32 written, int32 count)
+	{
+		uint8 *cursor = out + written;
+		if (count == 6)
+		{
+			for (int32 i = 0; i < 3; i++, cursor += 2)
+			{
+				FMemory::Memcpy(cursor, table.pairs[value % (symbols * symbols)], 2);
+				value /= symbols * symbols;
+			}
+			return;
+		}
+
+		for (int32 i = 0; i < count; i++)
+		{
+			*cursor++ = uint8(value % symbols);
+			value /= symbols;
+		}
+	});
+}
+
+uint64 FBookText::MakeKey(int32 seed, EKeyDomain domain, int32 index)
+{
+	return Random(uint64(uint32(seed)) << 32 | uint64(domain), uint64(uint32(index)));
+}
+
+uint64 FBookText::Random(uint64 key, uint64 counter)
+{
+	// SplitMix64 finalizer over a Weyl step, a different counter gives unrelated bits
+	uint64 z = key + (counter + 1) * 0x9E3779B97F4A7C15ull;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+int32 FBookText::PageLength(int32 seed, int32 page, int32 pageCount, int32 lineLength, int32 lineCount)
+{
+	int32 characters = lineLength * lineCount;
+
+	// Last page could have less characters
+	if (page == pageCount && characters > 0)
+		characters = 1 + Range(Random(MakeKey(seed, KEY_PAGE, page), MAX_uint64), characters);
+
+	return characters;
+}
+
+FString FBookText::GeneratePage(int32 seed, int32 page, int32 pageCount, int32 lineLength, int32 lineCount)
+{
+	// Out of bounds
+	if (page < 1 || page > pageCount)
+		return FString();
+
+	return Generate(MakeKey(seed, KEY_PAGE, page), PageLength(seed, page, pageCount, lineLength, lineCount), lineLength);
+}
+
+FString FBookText::GenerateTitle(int32 seed, int32 maxLength)
+{
+	uint64 key = MakeKey(seed, KEY_TITLE);
+	return Generate(key, TitleLength(key, maxLength), 0, false);
+}
+
+void FBookText::FormatTitle(int32 seed, int32 maxLength, int32 lineLength, FString &outSpine, FString &outCover)
+{
+	TCHAR spine[maxTitleLength];
+	TCHAR cover[maxTitleLength * 3];
+	int32 spineLength;
+	int32 coverLength;
+	FormatTitleInto(seed, FMath::Min(maxLength, maxTitleLength), lineLength, spine, spineLength, cover, coverLength);
+
+	outSpine = FString(spineLength, spine);
+	outCover = FString(coverLength, cover);
+}
+
+FString FBookText::FormatSpine(int32 seed, int32 maxLength)
+{
+	TCHAR spine[maxTitleLength];
+	int32 spineLength;
+	int32 coverLength;
+	FormatTitleInto(seed, FMath::Min(maxLength, maxTitleLength), 0, spine, spineLength, nullptr, coverLength);
+
+	return FString(spineLength, spine);
+}
+
+void FBookText::FormatTitleInto(int32 seed, int32 maxLength, int32 lineLength, TCHAR *outSpine, int32 &outSpineLength, TCHAR *outCover, int32 &outCoverLength)
+{
+	// Symbols go straight into the spine, which is compacted as it is read
+	uint64 key = MakeKey(seed, KEY_TITLE);
+	int32 length = TitleLength(key, maxLength);
+	GenerateSymbols(key, length, false, outSpine);
+
+	int32 spineLength = 0;
+	int32 coverLength = 0;
+	int32 wordStart = INDEX_NONE;
+	int32 lineUsed = 0; // Cover line so far, counting a space after its last word
+
+	// Spaces only go between words, so neither buffer is written past the text it ends up holding.
+	// A space past the end finishes the last word
+	for (int32 i = 0; i <= length; i++)
+	{
+		TCHAR c = i < length ? outSpine[i] : TEXT(' ');
+		if (c != TEXT(' '))
+		{
+			// Capital at the start of each word
+			if (wordStart == INDEX_NONE)
+			{
+				if (spineLength > 0)
+					outSpine[spineLength++] = TEXT(' ');
+
+				wordStart = spineLength;
+				if (c >= TEXT('a') && c <= TEXT('z'))
+					c += TEXT('A') - TEXT('a');
+			}
+			outSpine[spineLength++] = c;
+			continue;
+		}
+
+		// Leading and repeated spaces
+		if (wordStart == INDEX_NONE)
+			continue;
+
+		const TCHAR *word = outSpine + wordStart;
+		int32 wordLength = spineLength - wordStart;
+		wordStart = INDEX_NONE;
+
+		while (outCover != nullptr)
+		{
+			if (lineUsed + wordLength <= lineLength || (lineUsed == 0 && lineLength < 2))
+			{
+				// Fits on this line, or there is no room to split it
+				if (lineUsed > 0)
+					outCover[coverLength++] = TEXT(' ');
+
+				FMemory::Memcpy(outCover + coverLength, word, wordLength * sizeof(TCHAR));
+				coverLength += wordLength;
+				lineUsed += wordLength + 1;
+				break;
+			}
+			else if (lineUsed != 0)
+			{
+				// Next line
+				outCover[coverLength++] = TEXT('\n');
+				lineUsed = 0;
+			}
+			else
+			{
+				// Too long for any line, split with a hyphen
+				FMemory::Memcpy(outCover + coverLength, word, (lineLength - 1) * sizeof(TCHAR));
+				coverLength += lineLength - 1;
+				outCover[coverLength++] = TEXT('-');
+				outCover[coverLength++] = TEXT('\n');
+				word += lineLength - 1;
+				wordLength -= lineLength - 1;
+			}
+		}
+	}
+
+	outSpineLength = spineLength;
+	outCoverLength = coverLength;
+}
+
+FString FBookText::Generate(uint64 key, int32 length, int32 lineSize, bool punctuation)
+{
+	length = FMath::Max(length, 0);
+	int32 outputLength = OutputLength(length, lineSize);
+
+	FString result;
+	if (outputLength == 0)
+		return result;
+
+	// Fill the string's buffer directly
+	TArray<TCHAR> &chars = result.GetCharArray();
+	chars.SetNumUninitialized(outputLength + 1);
+	GenerateInto(key, length, lineSize, punctuation, chars.GetData());
+	chars[outputLength] = 0;
+
+	return result;
+}
+
+void FBookText::GenerateInto(uint64 key, int32 length, int32 lineSize, bool punctuation, TCHAR *out)
+{
+	GenerateSymbols(key, length, punctuation, out);
+	if (lineSize <= 0)
+		return;
+
+	// Spread lines out from the end, newlines after every lineSize
+	for (int32 line = length / lineSize; line >= 0; line--)
+	{
+		int32 count = FMath::Min(lineSize, length - line * lineSize);
+		if (count <= 0)
+			continue;
+
+		TCHAR *to = out + line * (lineSize + 1);
+		FMemory::Memmove(to, out + line * lineSize, count * sizeof(TCHAR));
+		if (count == lineSize)
+			to[lineSize] = '\n';
+	}
+}
+
+void FBookText::GeneratePacked(uint64 key, int32 length, bool punctuation, uint64 *out)
+{
+	FMemory::Memzero(out, PackedWords(length) * sizeof(uint64));
+
+	if (punctuation)
+		GeneratePackedOf<alphabetSize>(key, length, out);
+	else
+		GeneratePackedOf<unpunctuatedSize>(key, length, out);
+}
+
+void FBookText::GenerateIndices(uint64 key, int32 length, bool punctuation, uint8 *out)
+{
+	if (punctuation)
+		GenerateIndicesOf<alphabetSize>(key, length, out);
+	else
+		GenerateIndicesOf<unpunctuatedSize>(key, length, out);
+}
+
+void FBookText::Unpack(const uint64 *packed, int32 length, int32 lineSize, TCHAR *out)
+{
+	static const uint64 symbolMask = (1 << packedBits) - 1;
+
+	int32 line = 0;
+	for (int32 i = 0; i < length; i++)
+	{
+		*out++ = alphabet[(packed[i / symbolsPerWord] >> ((i % symbolsPerWord) * packedBits)) & symbolMask];
+
+		if (lineSize > 0 && ++line == lineSize)
+		{
+			*out++ = '\n';
+			line = 0;
+		}
+	}
+}
+
+void FBookText::GenerateSymbols(uint64 key, int32 length, bool punctuation, TCHAR *out)
+{
+	if (punctuation)
+		GenerateSymbolsOf<alphabetSize>(key, length, out);
+	else
+		GenerateSymbolsOf<unpunctuatedSize>(key, length, out);
+}
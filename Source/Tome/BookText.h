@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Book text as pure functions of a book seed, so any page can be made directly, in any order, on any thread.
+// Text comes from a counter-based generator: a hash of a key (book seed and what is being generated) and a counter.
+// Each 64 bit word gives up to 12 symbols, mapped two at a time through a table
+struct TOME_API FBookText
+{
+	// Symbols text is made of, the last two are punctuation
+	static const TCHAR alphabet[];
+	static const int32 alphabetSize = 29;
+	static const int32 unpunctuatedSize = alphabetSize - 2; // Letters and space
+
+	// What a key generates, so pages and titles of the same book don't share numbers
+	enum EKeyDomain : uint32
+	{
+		KEY_PAGE = 0x50414745,  // "PAGE"
+		KEY_TITLE = 0x5449544C, // "TITL"
+	};
+
+	// Key for part of a book
+	static uint64 MakeKey(int32 seed, EKeyDomain domain, int32 index = 0);
+
+	// Random 64 bits for a key and counter
+	static uint64 Random(uint64 key, uint64 counter);
+
+	// Map random bits to [0, range)
+	static int32 Range(uint64 random, int32 range) { return int32((uint64(uint32(random >> 32)) * uint64(range)) >> 32); }
+
+	// Characters on a page, the last page is shorter
+	static int32 PageLength(int32 seed, int32 page, int32 pageCount, int32 lineLength, int32 lineCount);
+
+	// Text of a page (1 to pageCount) with a newline after every line, empty if out of bounds
+	static FString GeneratePage(int32 seed, int32 page, int32 pageCount, int32 lineLength, int32 lineCount);
+
+	// Text before formatting for the spine and cover, no punctuation
+	static FString GenerateTitle(int32 seed, int32 maxLength);
+
+	// Longest title FormatTitle and FormatSpine make, maxLength is clamped to it
+	static const int32 maxTitleLength = 256;
+
+	// Characters a cover can take for a title of up to maxLength, a spine never takes more than maxLength.
+	// Split words add a hyphen and newline
+	static int32 MaxCoverLength(int32 maxLength) { return maxLength * 3; }
+
+	// Title as shown on a book. The spine is trimmed, single spaced and title cased, the cover is that wrapped at
+	// lineLength with words too long for a line split by a hyphen. One pass, one allocation per string
+	static void FormatTitle(int32 seed, int32 maxLength, int32 lineLength, FString &outSpine, FString &outCover);
+
+	// Spine text of FormatTitle
+	static FString FormatSpine(int32 seed, int32 maxLength);
+
+	// Format into buffers of exactly maxLength and MaxCoverLength(maxLength) characters, nothing is written past
+	// them and there are no terminators. outCover can be null
+	static void FormatTitleInto(int32 seed, int32 maxLength, int32 lineLength, TCHAR *outSpine, int32 &outSpineLength, TCHAR *outCover, int32 &outCoverLength);
+
+	// length characters from a key, with a newline after every lineSize (0 for none)
+	static FString Generate(uint64 key, int32 length, int32 lineSize = 0, bool punctuation = true);
+
+	// Characters Generate makes for length symbols, including newlines
+	static int32 OutputLength(int32 length, int32 lineSize) { return lineSize > 0 ? length + length / lineSize : length; }
+
+	// Generate into a buffer of at least OutputLength characters, no terminator
+	static void GenerateInto(uint64 key, int32 length, int32 lineSize, bool punctuation, TCHAR *out);
+
+	// Packed text is alphabet indices at 5 bits each, 12 to a word from the low bits up
+	static const int32 packedBits = 5;
+	static const int32 symbolsPerWord = 12;
+	static int32 PackedWords(int32 length) { return (length + symbolsPerWord - 1) / symbolsPerWord; }
+
+	// Same text as Generate without newlines, packed into PackedWords words
+	static void GeneratePacked(uint64 key, int32 length, bool punctuation, uint64 *out);
+
+	// Same text as Generate without newlines, as alphabet indices
+	static void GenerateIndices(uint64 key, int32 length, bool punctuation, uint8 *out);
+
+	// Expand packed text into OutputLength characters with a newline after every lineSize (0 for none), no terminator
+	static void Unpack(const uint64 *packed, int32 length, int32 lineSize, TCHAR *out);
+
+private:
+	// Write length symbols, no newlines
+	static void GenerateSymbols(uint64 key, int32 length, bool punctuation, TCHAR *out);
+
+	// Symbols in the title for a key
+	static int32 TitleLength(uint64 key, int32 maxLength) { return 1 + Range(Random(key, MAX_uint64), FMath::Max(maxLength, 1)); }
+};
@@ -0,0 +1,21 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BookTitleBatch.h"
+
+void FBookTitleBatch::Format()
+{
+	// The layout depends on it, FormatTitle clamps the same way
+	maxLength = FMath::Clamp(maxLength, 1, FBookText::maxTitleLength);
+
+	int32 stride = GetStride();
+	text.SetNumUninitialized(seeds.Num() * stride);
+	spineLengths.SetNumZeroed(seeds.Num());
+	coverLengths.SetNumZeroed(seeds.Num());
+
+	TCHAR *out = text.GetData();
+	for (int32 i = 0; i < seeds.Num() && !cancelled; i++, out += stride)
+		FBookText::FormatTitleInto(seeds[i], maxLength, lineLength, out, spineLengths[i], out + maxLength, coverLengths[i]);
+
+	done = true;
+}
@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "BookText.h"
+
+// Titles of many books formatted in one pass into one buffer (see FBookText::FormatTitle), shared between the
+// game thread and the task formatting them
+struct TOME_API FBookTitleBatch
+{
+	TArray<int32> seeds;
+	int32 maxLength = 0; // At most FBookText::maxTitleLength
+	int32 lineLength = 0;
+
+	// Spine then cover of each seed, GetStride apart. The cover starts right after the spine's maxLength
+	// characters, FBookText::FormatTitleInto writes nothing past either
+	TArray<TCHAR> text;
+	TArray<int32> spineLengths;
+	TArray<int32> coverLengths;
+
+	FThreadSafeBool cancelled;
+	FThreadSafeBool done;
+
+	// Format every seed, stopping early if cancelled
+	void Format();
+
+	int32 GetStride() const { return maxLength + FBookText::MaxCoverLength(maxLength); }
+	const TCHAR *GetSpine(int32 index) const { return text.GetData() + index * GetStride(); }
+	const TCHAR *GetCover(int32 index) const { return GetSpine(index) + maxLength; }
+};
@@ -0,0 +1,173 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GlyphTextComponent.h"
+#include "Engine/Texture2D.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "BookText.h"
+
+// Bound to const references by TArray::Init
+const uint8 UGlyphTextComponent::GLYPH_BLANK;
+
+UGlyphTextComponent::UGlyphTextComponent()
+{
+	SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	SetGenerateOverlapEvents(false);
+	CastShadow = false;
+}
+
+uint8 UGlyphTextComponent::GlyphIndex(TCHAR c)
+{
+	// Built once from the atlas order
+	struct FGlyphTable
+	{
+		FGlyphTable()
+		{
+			FMemory::Memset(glyphs, GLYPH_BLANK, sizeof(glyphs));
+			for (int32 i = 0; i < FBookText::alphabetSize; i++)
+				glyphs[FBookText::alphabet[i]] = uint8(i);
+			for (int32 i = 0; i < 26; i++)
+				glyphs['A' + i] = uint8(FBookText::alphabetSize + i);
+			glyphs['-'] = uint8(FBookText::alphabetSize + 26);
+
+			// Spaces don't need drawing
+			glyphs[' '] = GLYPH_BLANK;
+		}
+
+		uint8 glyphs[128];
+	};
+	static const FGlyphTable table;
+
+	return uint32(c) < 128 ? table.glyphs[c] : GLYPH_BLANK;
+}
+
+void UGlyphTextComponent::SetGlyphText(const FString &text)
+{
+	glyphs_.Init(GLYPH_BLANK, FMath::Max(columns * rows, 0));
+
+	int32 column = 0;
+	int32 row = 0;
+	for (TCHAR c : text)
+	{
+		if (c == '\n' || column == columns)
+		{
+			column = 0;
+			row++;
+		}
+		if (row == rows)
+			break;
+		if (c == '\n')
+			continue;
+
+		glyphs_[row * columns + column++] = GlyphIndex(c);
+	}
+
+	Upload();
+}
+
+void UGlyphTextComponent::SetPackedText(const uint64 *packed, int32 length)
+{
+	static const uint64 symbolMask = (1 << FBookText::packedBits) - 1;
+
+	glyphs_.Init(GLYPH_BLANK, FMath::Max(columns * rows, 0));
+
+	// Alphabet indices are glyph indices, apart from spaces
+	int32 cells = FMath::Min(length, glyphs_.Num());
+	for (int32 i = 0; i < cells; i++)
+	{
+		uint8 symbol = uint8((packed[i / FBookText::symbolsPerWord] >> ((i % FBookText::symbolsPerWord) * FBookText::packedBits)) & symbolMask);
+		glyphs_[i] = FBookText::alphabet[symbol] == ' ' ? GLYPH_BLANK : symbol;
+	}
+
+	Upload();
+}
+
+void UGlyphTextComponent::ClearGlyphText()
+{
+	glyphs_.Init(GLYPH_BLANK, FMath::Max(columns * rows, 0));
+	Upload();
+}
+
+void UGlyphTextComponent::SetGridSize(int32 newColumns, int32 newRows)
+{
+	if (newColumns == columns && newRows == rows)
+		return;
+
+	columns = newColumns;
+	rows = newRows;
+	if (IsRegistered())
+		CreateGlyphMaterial();
+}
+
+void UGlyphTextComponent::OnRegister()
+{
+	Super::OnRegister();
+
+	CreateGlyphMaterial();
+}
+
+void UGlyphTextComponent::CreateGlyphMaterial()
+{
+	columns = FMath::Max(columns, 1);
+	rows = FMath::Max(rows, 1);
+	glyphs_.Init(GLYPH_BLANK, columns * rows);
+	uploaded_.Reset();
+
+	if (glyphMaterial == nullptr)
+		return;
+
+	if (glyphTexture_ == nullptr || glyphTexture_->GetSizeX() != columns || glyphTexture_->GetSizeY() != rows)
+		glyphTexture_ = CreateGlyphTexture(columns, rows);
+
+	if (material_ == nullptr || material_->Parent != glyphMaterial)
+		material_ = UMaterialInstanceDynamic::Create(glyphMaterial, this);
+
+	material_->SetTextureParameterValue(TEXT("GlyphIndices"), glyphTexture_);
+	material_->SetVectorParameterValue(TEXT("GridSize"), FLinearColor(float(columns), float(rows), 0.0f, 0.0f));
+	SetMaterial(0, material_);
+
+	Upload();
+}
+
+void UGlyphTextComponent::Upload()
+{
+	if (glyphTexture_ == nullptr || glyphs_.Num() != columns * rows || glyphs_ == uploaded_)
+		return;
+
+	uploaded_ = glyphs_;
+	UploadGlyphs(glyphTexture_, glyphs_, columns, rows);
+}
+
+UTexture2D *UGlyphTextComponent::CreateGlyphTexture(int32 gridColumns, int32 gridRows)
+{
+	// Point sampled indices, nothing that would blend neighboring glyphs
+	UTexture2D *texture = UTexture2D::CreateTransient(gridColumns, gridRows, PF_G8);
+	texture->Filter = TF_Nearest;
+	texture->SRGB = false;
+	texture->CompressionSettings = TC_Grayscale;
+	texture->AddressX = TA_Clamp;
+	texture->AddressY = TA_Clamp;
+	texture->UpdateResource();
+
+	TArray<uint8> blank;
+	blank.Init(GLYPH_BLANK, gridColumns * gridRows);
+	UploadGlyphs(texture, blank, gridColumns, gridRows);
+	return texture;
+}
+
+void UGlyphTextComponent::UploadGlyphs(UTexture2D *texture, const TArray<uint8> &glyphs, int32 gridColumns, int32 gridRows)
+{
+	if (texture == nullptr || glyphs.Num() < gridColumns * gridRows)
+		return;
+
+	// The render thread reads the copy later and frees it
+	uint8 *data = new uint8[gridColumns * gridRows];
+	FMemory::Memcpy(data, glyphs.GetData(), gridColumns * gridRows);
+	FUpdateTextureRegion2D *region = new FUpdateTextureRegion2D(0, 0, 0, 0, gridColumns, gridRows);
+
+	texture->UpdateTextureRegions(0, 1, region, gridColumns, 1, data, [](uint8 *uploaded, const FUpdateTextureRegion2D *uploadedRegion)
+	{
+		delete[] uploaded;
+		delete uploadedRegion;
+	});
+}
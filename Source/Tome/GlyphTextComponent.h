@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/StaticMeshComponent.h"
+#include "GlyphTextComponent.generated.h"
+
+class UTexture2D;
+class UMaterialInstanceDynamic;
+
+// Draws a grid of monospaced glyphs on its mesh with one material. Each cell's glyph is a texel of a small data
+// texture, which the material looks up in a glyph atlas, so changing text only uploads the glyph indices.
+// glyphMaterial gets the indices as texture parameter GlyphIndices (G8, nearest, one texel per cell, 255 for blank)
+// and the grid as vector parameter GridSize (columns, rows). Atlas glyphs are in GlyphIndex order
+UCLASS(ClassGroup = (Rendering), meta = (BlueprintSpawnableComponent))
+class TOME_API UGlyphTextComponent : public UStaticMeshComponent
+{
+	GENERATED_BODY()
+
+public:
+	UGlyphTextComponent();
+
+	// Atlas order is the book alphabet (see FBookText), then capitals, then a hyphen
+	static const uint8 GLYPH_BLANK = 255;
+	static uint8 GlyphIndex(TCHAR c);
+
+	// Glyph index texture for a grid, filled with blanks
+	static UTexture2D *CreateGlyphTexture(int32 gridColumns, int32 gridRows);
+
+	// Send a grid of glyph indices to a texture made by CreateGlyphTexture
+	static void UploadGlyphs(UTexture2D *texture, const TArray<uint8> &glyphs, int32 gridColumns, int32 gridRows);
+
+	// Whether there is a material to draw with, text render components are used otherwise
+	bool IsReady() const { return material_ != nullptr; }
+
+	// Show text, newlines start a new row and long rows wrap
+	UFUNCTION(BlueprintCallable)
+	void SetGlyphText(const FString &text);
+
+	// Show packed book text (see FBookText), rows of columns symbols
+	void SetPackedText(const uint64 *packed, int32 length);
+
+	// Blank every cell
+	UFUNCTION(BlueprintCallable)
+	void ClearGlyphText();
+
+	// Change the grid, clearing it
+	UFUNCTION(BlueprintCallable)
+	void SetGridSize(int32 newColumns, int32 newRows);
+
+protected:
+	virtual void OnRegister() override;
+
+private:
+	// Make the texture and material for the grid
+	void CreateGlyphMaterial();
+
+	// Send glyphs_ to the texture if they changed since the last upload
+	void Upload();
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	UMaterialInterface *glyphMaterial = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	int32 columns = 24;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	int32 rows = 15;
+
+private:
+	UPROPERTY(Transient)
+	UTexture2D *glyphTexture_ = nullptr;
+
+	UPROPERTY(Transient)
+	UMaterialInstanceDynamic *material_ = nullptr;
+
+	// One glyph index per cell, row by row
+	TArray<uint8> glyphs_;
+	TArray<uint8> uploaded_;
+};
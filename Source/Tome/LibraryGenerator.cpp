@@ -2,6 +2,12 @@
 
 
 #include "LibraryGenerator.h"
+#include "BookRow.h"
+#include "Async/Async.h"
+#include "GameFramework/PlayerController.h"
+#include "TomeStats.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogLibraryGenerator, Log, All);
 
 const FIntVector ALibraryGenerator::directions[] = {
 	FIntVector(-1, 0, 0),
@@ -30,6 +36,19 @@ ALibraryGenerator::ALibraryGenerator()
 void ALibraryGenerator::BeginPlay()
 {
 	Super::BeginPlay();
+
+	solveRandom_.GenerateNewSeed();
+	CompileTileRules();
+}
+
+// Called when the game ends or when destroyed
+void ALibraryGenerator::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Stop solving, the task only touches the batch so it doesn't need to be waited on
+	if (solveBatch_.IsValid())
+		solveBatch_->cancelled = true;
+
+	Super::EndPlay(EndPlayReason);
 }
 
 FIntVector ALibraryGenerator::WorldToGrid(FVector world)
@@ -45,290 +64,1280 @@ FVector ALibraryGenerator::GridToWorld(FIntVector grid)
 
 ETileDirection ALibraryGenerator::ReverseDirection(ETileDirection direction)
 {
-	return ETileDirection(uint8(direction) + ((uint8(direction) % 2) ? -1 : 1));
+	return FTileRules::ReverseDirection(direction);
 }
 
 ETileDirection ALibraryGenerator::RotateDirection(ETileDirection direction, ETileRotation rotation)
 {
-	if (direction == ETileDirection::TD_ABOVE || direction == ETileDirection::TD_BELOW || rotation == ETileRotation::ROT_0)
-		return direction;
+	return FTileRules::RotateDirection(direction, rotation);
+}
+
+ETileDirection ALibraryGenerator::ScaleDirection(ETileDirection direction, FVector scale)
+{
+	return FTileRules::ScaleDirection(direction, scale);
+}
+
+ETileRotation ALibraryGenerator::ReverseRotation(ETileRotation rotation)
+{
+	return FTileRules::ReverseRotation(rotation);
+}
+
+ETileConnection ALibraryGenerator::GetConnection(const FTileInfo *info, ETileDirection direction, ETileRotation rotation, FVector scale)
+{
+	return FTileRules::GetConnection(info, direction, rotation, scale);
+}
+
+ETileRotation ALibraryGenerator::ActorTileRotation(AActor *actor)
+{
+	return ETileRotation(PositiveMod(FMath::RoundToInt(actor->GetActorRotation().Yaw / 90.0f), uint32(ETileRotation::ROT_MAX)));
+}
+
+int32 ALibraryGenerator::PositiveMod(int32 value, int32 mod)
+{
+	if (value >= 0)
+		return value % mod;
+	else
+		return (1 - (value + 1) / mod) * mod + value;
+}
+
+void ALibraryGenerator::CompileTileRules()
+{
+	// Loaded and cached tiles are variants of the old rules, unload them while their variants still resolve
+	TArray<FIntVector> loaded;
+	tiles_.GetCoords(loaded);
+	for (const FIntVector &coord : loaded)
+		UnloadTile(coord);
+	tileCache_.Empty();
+	streamingValid_ = false;
+
+	// Solve tasks keep the old rules alive until they finish
+	TSharedRef<FTileRules, ESPMode::ThreadSafe> rules = MakeShared<FTileRules, ESPMode::ThreadSafe>();
+	rules->Compile(tileData);
+	rules_ = rules;
+}
+
+void ALibraryGenerator::UpdateTileRules()
+{
+	if (rules_->GetSource() != tileData)
+		CompileTileRules();
+}
+
+#if WITH_EDITOR
+void ALibraryGenerator::PostEditChangeProperty(FPropertyChangedEvent &PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	if (PropertyChangedEvent.GetPropertyName() == GET_MEMBER_NAME_CHECKED(ALibraryGenerator, tileData))
+		CompileTileRules();
+}
+#endif
+
+void ALibraryGenerator::GenerateTile(FIntVector coord)
+{
+	TOME_SCOPE(GenerateTile);
+
+	UpdateTileRules();
+
+	// Gather what is next to this tile
+	int32 neighbors[uint8(ETileDirection::TD_MAX)];
+	GetNeighbors(coord, neighbors);
+
+	// Bring back what was here before without solving
+	if (LoadCachedTile(coord, neighbors))
+		return;
+
+	int32 variant;
+	if (solver == ETileSolver::Chunk)
+		variant = SolveChunk(coord);
+	else
+	{
+		// Random tile+rotation that fits, only spawn tiles at the origin
+		uint32 roll = hashedGeneration ? FTileRules::HashCoord(worldSeed, coord) : solveRandom_.GetUnsignedInt();
+		int32 candidates;
+		variant = rules_->Solve(neighbors, coord == FIntVector(0, 0, 0), roll, &candidates);
+
+		FTomeStats::solves++;
+		FTomeStats::solveCandidates += candidates;
+	}
+
+	// No possible tiles for this space
+	if (variant == FTileRules::VARIANT_EMPTY)
+	{
+		// Add empty
+		tiles_.Add(coord, FTileRules::VARIANT_EMPTY);
+	}
+	else
+		AddTile(coord, variant);
+}
+
+void ALibraryGenerator::GetNeighbors(FIntVector coord, int32 outNeighbors[uint8(ETileDirection::TD_MAX)])
+{
+	tiles_.GetNeighbors(coord, outNeighbors);
+}
 
-	if (rotation == ETileRotation::ROT_180)
-		return ReverseDirection(direction);
+bool ALibraryGenerator::LoadCachedTile(FIntVector coord, const int32 neighbors[uint8(ETileDirection::TD_MAX)])
+{
+	int32 variant = tileCache_.Find(coord);
+
+	// Neighbors may have been solved differently since this was cached
+	if (variant == FTileRules::VARIANT_UNLOADED || !rules_->Fits(variant, neighbors, coord == FIntVector(0, 0, 0)))
+		return false;
+
+	if (variant == FTileRules::VARIANT_EMPTY)
+		tiles_.Add(coord, FTileRules::VARIANT_EMPTY);
+	else
+		AddTile(coord, variant);
+
+	tileCacheHits++;
+	return true;
+}
+
+int32 ALibraryGenerator::SolveChunk(FIntVector coord)
+{
+	FIntVector origin = ChunkOrigin(coord);
+	FIntVector size(FMath::Max(chunkSize.X, 1), FMath::Max(chunkSize.Y, 1), FMath::Max(chunkSize.Z, 1));
 
-	if (rotation == ETileRotation::ROT_90)
+	// Loaded and remembered cells stay as they are, except coord which didn't fit or wasn't cached
+	auto known = [this, coord](FIntVector cell)
 	{
-		switch (direction)
+		int32 loaded = tiles_.Find(cell);
+		if (loaded != FTileRules::VARIANT_UNLOADED || cell == coord)
+			return loaded;
+		return tileCache_.Peek(cell);
+	};
+
+	FTileChunkSolver chunkSolver(*rules_);
+	TArray<int32> variants;
+	chunkSolver.Solve(origin, size, known, hashedGeneration ? worldSeed : int32(solveRandom_.GetUnsignedInt()), hashedGeneration, chunkBacktrackBudget, variants);
+	lastChunkBacktracks = chunkSolver.backtracks;
+	lastChunkHoles = chunkSolver.holes;
+	lastChunkConflicts = chunkSolver.conflicts;
+	if (chunkSolver.conflicts > 0)
+		UE_LOG(LogLibraryGenerator, Verbose, TEXT("%d loaded tiles conflict in chunk at %s"), chunkSolver.conflicts, *origin.ToString());
+
+	// Rest of the chunk loads from the cache as it streams in
+	tileCache_.SetCapacityBytes(TileCacheCapacity());
+	int32 result = FTileRules::VARIANT_EMPTY;
+	for (int32 i = 0; i < variants.Num(); i++)
+	{
+		FIntVector cell = origin + FIntVector(i % size.X, (i / size.X) % size.Y, i / (size.X * size.Y));
+		if (cell == coord)
+			result = variants[i];
+		else if (known(cell) == FTileRules::VARIANT_UNLOADED)
+			tileCache_.Store(cell, variants[i]);
+	}
+	tileCacheUsedBytes = tileCache_.GetUsedBytes();
+
+	return result;
+}
+
+// Integer division rounding down, so chunks don't straddle zero
+static FIntVector FloorDivide(FIntVector coord, FIntVector size)
+{
+	FIntVector result;
+	for (int32 i = 0; i < 3; i++)
+	{
+		int32 divisor = FMath::Max(size[i], 1);
+		result[i] = coord[i] >= 0 ? coord[i] / divisor : (coord[i] - divisor + 1) / divisor;
+	}
+	return result;
+}
+
+FIntVector ALibraryGenerator::ChunkOrigin(FIntVector coord) const
+{
+	FIntVector chunk = FloorDivide(coord, chunkSize);
+	return FIntVector(chunk.X * FMath::Max(chunkSize.X, 1), chunk.Y * FMath::Max(chunkSize.Y, 1), chunk.Z * FMath::Max(chunkSize.Z, 1));
+}
+
+int32 ALibraryGenerator::TileCacheCapacity() const
+{
+	if (solver != ETileSolver::Chunk)
+		return tileCacheBytes;
+
+	// A chunk and the ones around it, or every tile of a chunk would solve the whole chunk again
+	static const int32 cachedChunks = 3 * 3 * 3;
+	return FMath::Max(tileCacheBytes, cachedChunks * FTileCache::GetBytesFor(chunkSize));
+}
+
+FIntVector ALibraryGenerator::FarChunkCoord(FIntVector coord) const
+{
+	return FloorDivide(coord, farChunkSize);
+}
+
+void ALibraryGenerator::AddTile(FIntVector coord, int32 variant)
+{
+	TOME_SCOPE(AddTile);
+
+	const FTileVariant &tile = rules_->GetVariant(variant);
+
+	// Final transform relative to geometry parent, including mirror
+	FTransform transform(FRotator(0.0f, rotations[uint8(tile.rotation)], 0.0f), GridToWorld(coord), tile.GetScale());
+
+	// Far tiles are drawn by their chunk
+	ETileTier tier = GetTileTier(coord);
+	if (tier == ETileTier::Far)
+	{
+		tiles_.Add(coord, variant, FTileGrid::CELL_FAR);
+		dirtyFarChunks_.Add(FarChunkCoord(coord));
+		return;
+	}
+
+	// Nearer tiles get their own proxy instance
+	if (tier == ETileTier::Proxy)
+	{
+		uint32 flags = FTileGrid::CELL_PROXY;
+		if (tile.info->proxyMesh != nullptr)
 		{
-		case ETileDirection::TD_LEFT:
-			return ETileDirection::TD_BACK;
-		case ETileDirection::TD_RIGHT:
-			return ETileDirection::TD_FRONT;
-		case ETileDirection::TD_BACK:
-			return ETileDirection::TD_RIGHT;
-		case ETileDirection::TD_FRONT:
-			return ETileDirection::TD_LEFT;
+			int32 component = GetProxyComponent(tile.info->proxyMesh, tile.mirrored);
+			tileInstances_.Add(coord).Add({ component, AddInstance(component, transform) });
+			flags |= FTileGrid::CELL_INSTANCED;
 		}
+		tiles_.Add(coord, variant, flags);
+		return;
 	}
 
-	if (rotation == ETileRotation::ROT_270)
+	// Draw with instances if nothing on this tile needs an actor
+	if (instancedRendering && AddTileInstances(coord, tile, transform))
+	{
+		tiles_.Add(coord, variant, FTileGrid::CELL_INSTANCED);
+		return;
+	}
+
+	AActor *actor = TakePooledTile(tile.info->object.Get(), tile.mirrored);
+	if (actor != nullptr)
+	{
+		// Reuse parked tile
+		actor->SetActorRelativeTransform(transform);
+		tilePoolHits++;
+	}
+	else
 	{
-		switch (direction)
+		// Spawn with scale already applied so render state is built once
+		actor = GetWorld()->SpawnActor(tile.info->object.Get(), &transform);
+		actor->AttachToActor(geometryParent, { EAttachmentRule::KeepRelative, false });
+		tilePoolMisses++;
+	}
+
+	// Add to data structure
+	tiles_.Add(coord, variant, FTileGrid::CELL_ACTOR);
+	tileActors_.Add(coord, actor);
+}
+
+void ALibraryGenerator::UnloadTile(FIntVector coord)
+{
+	TOME_SCOPE(UnloadTile);
+
+	// Remove from grid
+	int32 variant;
+	uint32 flags;
+	if (!tiles_.Remove(coord, variant, flags))
+		return;
+
+	// Remember what was here
+	tileCache_.SetCapacityBytes(TileCacheCapacity());
+	tileCache_.Store(coord, variant);
+	tileCacheUsedBytes = tileCache_.GetUsedBytes();
+
+	RemoveTileDrawing(coord, variant, flags);
+}
+
+void ALibraryGenerator::RemoveTileDrawing(FIntVector coord, int32 variant, uint32 flags)
+{
+	// Park instances
+	if (flags & FTileGrid::CELL_INSTANCED)
+		RemoveTileInstances(coord);
+
+	// Park actor
+	AActor *actor;
+	if ((flags & FTileGrid::CELL_ACTOR) && tileActors_.RemoveAndCopyValue(coord, actor))
+		ReleaseTile(actor, rules_->GetVariant(variant).mirrored);
+
+	// Chunk redraws without it
+	if (flags & FTileGrid::CELL_FAR)
+		dirtyFarChunks_.Add(FarChunkCoord(coord));
+}
+
+ETileTier ALibraryGenerator::GetTileTier(FIntVector coord)
+{
+	if (!tieredStreaming)
+		return ETileTier::Full;
+
+	float nearest = MAX_flt;
+	for (const FStreamingObserver &observer : observers_)
+	{
+		if (observer.valid)
+			nearest = FMath::Min(nearest, GridToWorld(coord - observer.center).SizeSquared());
+	}
+
+	if (nearest <= FMath::Square(fullTileDistance))
+		return ETileTier::Full;
+	return nearest <= FMath::Square(proxyTileDistance) ? ETileTier::Proxy : ETileTier::Far;
+}
+
+void ALibraryGenerator::UpdateTileTier(FIntVector coord)
+{
+	// Empty space draws nothing in any tier
+	int32 variant = tiles_.Find(coord);
+	if (variant < 0)
+		return;
+
+	uint32 flags = tiles_.FindFlags(coord);
+	ETileTier current = ETileTier::Full;
+	if (flags & FTileGrid::CELL_PROXY)
+		current = ETileTier::Proxy;
+	else if (flags & FTileGrid::CELL_FAR)
+		current = ETileTier::Far;
+
+	if (GetTileTier(coord) == current)
+		return;
+
+	RemoveTileDrawing(coord, variant, flags);
+	AddTile(coord, variant);
+}
+
+void ALibraryGenerator::RebuildFarChunks()
+{
+	FIntVector size(FMath::Max(farChunkSize.X, 1), FMath::Max(farChunkSize.Y, 1), FMath::Max(farChunkSize.Z, 1));
+
+	for (const FIntVector &chunkCoord : dirtyFarChunks_)
+	{
+		FFarChunk &chunk = farChunks_.FindOrAdd(chunkCoord);
+		for (TPair<TPair<UStaticMesh *, bool>, UInstancedStaticMeshComponent *> &component : chunk.components)
+			component.Value->ClearInstances();
+
+		// Batch proxies of every far tile in the chunk, a component per mesh
+		FIntVector origin(chunkCoord.X * size.X, chunkCoord.Y * size.Y, chunkCoord.Z * size.Z);
+		for (int32 z = 0; z < size.Z; z++)
 		{
-		case ETileDirection::TD_LEFT:
-			return ETileDirection::TD_FRONT;
-		case ETileDirection::TD_RIGHT:
-			return ETileDirection::TD_BACK;
-		case ETileDirection::TD_BACK:
-			return ETileDirection::TD_LEFT;
-		case ETileDirection::TD_FRONT:
-			return ETileDirection::TD_RIGHT;
+			for (int32 y = 0; y < size.Y; y++)
+			{
+				for (int32 x = 0; x < size.X; x++)
+				{
+					FIntVector coord = origin + FIntVector(x, y, z);
+					int32 variant = tiles_.Find(coord);
+					if (variant < 0 || !(tiles_.FindFlags(coord) & FTileGrid::CELL_FAR))
+						continue;
+
+					const FTileVariant &tile = rules_->GetVariant(variant);
+					if (tile.info->proxyMesh == nullptr)
+						continue;
+
+					UInstancedStaticMeshComponent *&component = chunk.components.FindOrAdd(TPair<UStaticMesh *, bool>(tile.info->proxyMesh, tile.mirrored));
+					if (component == nullptr)
+					{
+						component = NewObject<UInstancedStaticMeshComponent>(this);
+						component->SetStaticMesh(tile.info->proxyMesh);
+						component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+						component->CastShadow = false;
+						component->bReverseCulling = tile.mirrored;
+						if (geometryParent != nullptr)
+							component->SetupAttachment(geometryParent->GetRootComponent());
+						component->RegisterComponent();
+						farComponents_.Add(component);
+					}
+
+					component->AddInstance(FTransform(FRotator(0.0f, rotations[uint8(tile.rotation)], 0.0f), GridToWorld(coord), tile.GetScale()));
+				}
+			}
+		}
+
+		// Drop components left without tiles
+		for (auto it = chunk.components.CreateIterator(); it; ++it)
+		{
+			if (it.Value()->GetInstanceCount() == 0)
+			{
+				farComponents_.RemoveSingleSwap(it.Value());
+				it.Value()->DestroyComponent();
+				it.RemoveCurrent();
+			}
 		}
+
+		if (chunk.components.Num() == 0)
+			farChunks_.Remove(chunkCoord);
 	}
 
-	return ETileDirection::TD_MAX;
+	dirtyFarChunks_.Reset();
+	farChunkCount = farChunks_.Num();
 }
 
-ETileDirection ALibraryGenerator::ScaleDirection(ETileDirection direction, FVector scale)
+AActor *ALibraryGenerator::TakePooledTile(UClass *type, bool mirrored)
 {
-	if (scale.X < 0.0f)
+	TArray<FParkedTile> *pool = tilePool_.Find(TPair<UClass *, bool>(type, mirrored));
+
+	while (pool != nullptr && pool->Num() > 0)
 	{
-		if (direction == ETileDirection::TD_LEFT)
-			return ETileDirection::TD_RIGHT;
-		if (direction == ETileDirection::TD_RIGHT)
-			return ETileDirection::TD_LEFT;
+		FParkedTile parked = pool->Pop(false);
+
+		// Could have been destroyed by something else while parked
+		if (IsValid(parked.actor))
+		{
+			UnparkTile(parked.states);
+			return parked.actor;
+		}
 	}
-	if (scale.Y < 0.0f)
+	return nullptr;
+}
+
+void ALibraryGenerator::ReleaseTile(AActor *actor, bool mirrored)
+{
+	TArray<FParkedTile> &pool = tilePool_.FindOrAdd(TPair<UClass *, bool>(actor->GetClass(), mirrored));
+
+	// Pool full, destroy instead
+	if (pool.Num() >= tilePoolCapacity)
 	{
-		if (direction == ETileDirection::TD_BACK)
-			return ETileDirection::TD_FRONT;
-		if (direction == ETileDirection::TD_FRONT)
-			return ETileDirection::TD_BACK;
+		GetWorld()->DestroyActor(actor);
+		tilePoolEvictions++;
+		return;
 	}
-	if (scale.Z < 0.0f)
+
+	FParkedTile &parked = pool.AddDefaulted_GetRef();
+	parked.actor = actor;
+	ParkTile(actor, parked.states);
+}
+
+void ALibraryGenerator::ParkTile(AActor *actor, TArray<FParkedActorState> &outStates)
+{
+	outStates.Add({ actor, actor->IsHidden(), actor->GetActorEnableCollision(), actor->IsActorTickEnabled() });
+	actor->SetActorHiddenInGame(true);
+	actor->SetActorEnableCollision(false);
+	actor->SetActorTickEnabled(false);
+
+	// Shelves, books, etc
+	TArray<AActor *> children;
+	actor->GetAttachedActors(children);
+	for (AActor *child : children)
+		ParkTile(child, outStates);
+}
+
+void ALibraryGenerator::UnparkTile(const TArray<FParkedActorState> &states)
+{
+	// Anything destroyed or detached while parked is left alone
+	for (const FParkedActorState &state : states)
+	{
+		AActor *actor = state.actor.Get();
+		if (actor == nullptr)
+			continue;
+
+		actor->SetActorHiddenInGame(state.hidden);
+		actor->SetActorEnableCollision(state.collision);
+		actor->SetActorTickEnabled(state.tick);
+	}
+}
+
+const FTileClassMeshes &ALibraryGenerator::GetTileMeshes(UClass *type, bool mirrored)
+{
+	TPair<UClass *, bool> key(type, mirrored);
+	if (const FTileClassMeshes *found = tileClassMeshes_.Find(key))
+		return *found;
+
+	FTileClassMeshes meshes;
+
+	// Spawn a hidden copy at the origin to read its components
+	FActorSpawnParameters params;
+	params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	params.ObjectFlags |= RF_Transient;
+	AActor *prototype = GetWorld()->SpawnActor(type, &FTransform::Identity, params);
+	prototype->SetActorHiddenInGame(true);
+	prototype->SetActorEnableCollision(false);
+
+	TInlineComponentArray<USceneComponent *> components(prototype);
+
+	// Anything but static meshes (lights, child actors, shelves) needs the real actor
+	TArray<AActor *> attached;
+	prototype->GetAttachedActors(attached);
+	meshes.interactive = attached.Num() > 0;
+	for (USceneComponent *component : components)
+	{
+		if (component->IsEditorOnly() || component->GetClass() == USceneComponent::StaticClass())
+			continue;
+
+		UStaticMeshComponent *mesh = Cast<UStaticMeshComponent>(component);
+		if (mesh == nullptr || mesh->IsA<UInstancedStaticMeshComponent>())
+			meshes.interactive = true;
+	}
+
+	// Share a component for each mesh
+	if (!meshes.interactive)
 	{
-		if (direction == ETileDirection::TD_BELOW)
-			return ETileDirection::TD_ABOVE;
-		if (direction == ETileDirection::TD_ABOVE)
-			return ETileDirection::TD_BELOW;
+		for (USceneComponent *component : components)
+		{
+			UStaticMeshComponent *mesh = Cast<UStaticMeshComponent>(component);
+			if (mesh != nullptr && mesh->GetStaticMesh() != nullptr)
+				meshes.parts.Add({ GetInstanceComponent(mesh, mirrored), mesh->GetComponentTransform() });
+		}
 	}
 
-	return direction;
+	prototype->Destroy();
+
+	return tileClassMeshes_.Add(key, meshes);
 }
 
-ETileRotation ALibraryGenerator::ReverseRotation(ETileRotation rotation)
+int32 ALibraryGenerator::GetInstanceComponent(UStaticMeshComponent *source, bool mirrored)
 {
-	if (rotation == ETileRotation::ROT_90)
-		return ETileRotation::ROT_270;
+	// Meshes can only share a component if they draw and collide the same
+	FString key = source->GetStaticMesh()->GetPathName();
+	for (int32 i = 0; i < source->GetNumMaterials(); i++)
+		key += TEXT("|") + GetPathNameSafe(source->GetMaterial(i));
+	key += FString::Printf(TEXT("|%s|%d|%d|%d"), *source->GetCollisionProfileName().ToString(), int32(source->GetCollisionEnabled()), int32(source->bHiddenInGame), int32(mirrored));
+
+	if (const int32 *found = instanceComponentIndices_.Find(key))
+		return *found;
+
+	UHierarchicalInstancedStaticMeshComponent *component = NewObject<UHierarchicalInstancedStaticMeshComponent>(this);
+	component->SetStaticMesh(source->GetStaticMesh());
+	for (int32 i = 0; i < source->GetNumMaterials(); i++)
+		component->SetMaterial(i, source->GetMaterial(i));
+	component->SetCollisionProfileName(source->GetCollisionProfileName());
+	component->SetCollisionEnabled(source->GetCollisionEnabled());
+	component->SetHiddenInGame(source->bHiddenInGame);
+	component->CastShadow = source->CastShadow;
 
-	if (rotation == ETileRotation::ROT_270)
-		return ETileRotation::ROT_90;
+	// Culling follows the component transform, not instances, so mirrored instances get their own component
+	component->bReverseCulling = mirrored;
 
-	return rotation;
+	// Instances are placed relative to the geometry parent like tile actors
+	if (geometryParent != nullptr)
+		component->SetupAttachment(geometryParent->GetRootComponent());
+	component->RegisterComponent();
+
+	int32 index = instanceComponents_.Add(component);
+	freeInstances_.AddDefaulted();
+	instanceComponentIndices_.Add(key, index);
+	return index;
 }
 
-ETileConnection ALibraryGenerator::GetConnection(const FTileInfo *info, ETileDirection direction, ETileRotation rotation, FVector scale)
+bool ALibraryGenerator::AddTileInstances(FIntVector coord, const FTileVariant &tile, const FTransform &transform)
 {
-	return info->connections[uint8(ScaleDirection(RotateDirection(direction, ReverseRotation(rotation)), scale))];
+	const FTileClassMeshes &meshes = GetTileMeshes(tile.info->object.Get(), tile.mirrored);
+	if (meshes.interactive)
+		return false;
+
+	TArray<FTileMeshInstance> &instances = tileInstances_.Add(coord);
+	for (const FTileMeshPart &part : meshes.parts)
+		instances.Add({ part.component, AddInstance(part.component, part.relative * transform) });
+	return true;
 }
 
-ETileRotation ALibraryGenerator::ActorTileRotation(AActor *actor)
+int32 ALibraryGenerator::AddInstance(int32 component, const FTransform &transform)
 {
-	return ETileRotation(PositiveMod(FMath::RoundToInt(actor->GetActorRotation().Yaw / 90.0f), uint32(ETileRotation::ROT_MAX)));
+	// Reuse a parked instance so indices stay stable
+	TArray<int32> &free = freeInstances_[component];
+	if (free.Num() > 0)
+	{
+		int32 instance = free.Pop(false);
+		instanceComponents_[component]->UpdateInstanceTransform(instance, transform, false, true, true);
+		return instance;
+	}
+
+	return instanceComponents_[component]->AddInstance(transform);
 }
 
-int32 ALibraryGenerator::PositiveMod(int32 value, int32 mod)
+int32 ALibraryGenerator::GetProxyComponent(UStaticMesh *mesh, bool mirrored)
 {
-	if (value >= 0)
-		return value % mod;
-	else
-		return (1 - (value + 1) / mod) * mod + value;
+	TPair<UStaticMesh *, bool> key(mesh, mirrored);
+	if (const int32 *found = proxyComponentIndices_.Find(key))
+		return *found;
+
+	// Proxies are only seen from a distance, nothing collides with or is shadowed by them
+	UHierarchicalInstancedStaticMeshComponent *component = NewObject<UHierarchicalInstancedStaticMeshComponent>(this);
+	component->SetStaticMesh(mesh);
+	component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	component->CastShadow = false;
+	component->bReverseCulling = mirrored;
+
+	if (geometryParent != nullptr)
+		component->SetupAttachment(geometryParent->GetRootComponent());
+	component->RegisterComponent();
+
+	int32 index = instanceComponents_.Add(component);
+	freeInstances_.AddDefaulted();
+	proxyComponentIndices_.Add(key, index);
+	return index;
 }
 
-void ALibraryGenerator::GenerateTile(FIntVector coord)
+void ALibraryGenerator::RemoveTileInstances(FIntVector coord)
 {
-	// Array of possible tiles+rotations to generate
-	TArray<RotatedTile> possibilities;
+	TArray<FTileMeshInstance> instances;
+	if (!tileInstances_.RemoveAndCopyValue(coord, instances))
+		return;
 
-	// Try all tiles
-	for (const TPair<FName, uint8*> &row : tileData->GetRowMap())
+	// Removing instances reorders indices, so shrink them to nothing where they are instead. Zero scale isn't drawn,
+	// drops the instance's collision and keeps component bounds to the library
+	for (const FTileMeshInstance &instance : instances)
 	{
-		const FTileInfo *info = reinterpret_cast<FTileInfo *>(row.Value);
+		UHierarchicalInstancedStaticMeshComponent *component = instanceComponents_[instance.component];
 
-		// Check for spawn tiles
-		if (coord == FIntVector(0, 0, 0) && !info->canSpawnOn)
-			continue;
+		FTransform parked;
+		component->GetInstanceTransform(instance.instance, parked);
+		parked.SetScale3D(FVector::ZeroVector);
+
+		component->UpdateInstanceTransform(instance.instance, parked, false, true, true);
+		freeInstances_[instance.component].Add(instance.instance);
+	}
+}
+
+void ALibraryGenerator::UpdateStreamingOffsets()
+{
+	FVector extents(renderDistance, renderHeight, renderAbove);
+	if (offsetsShape_ == streamingShape && offsetsExtents_ == extents && offsetsBelow_ == renderBelow && offsetsHysteresis_ == unloadHysteresis && offsetsGridSize_ == gridSize)
+		return;
+
+	offsetsShape_ = streamingShape;
+	offsetsExtents_ = extents;
+	offsetsBelow_ = renderBelow;
+	offsetsHysteresis_ = unloadHysteresis;
+	offsetsGridSize_ = gridSize;
+	streamingValid_ = false;
+
+	float hysteresis = FMath::Max(unloadHysteresis, 0.0f);
+
+	// Vertical reach of the unload volume
+	float vertical = renderDistance;
+	if (streamingShape == EStreamingShape::Ellipsoid)
+		vertical = renderHeight;
+	else if (streamingShape == EStreamingShape::Cylinder)
+		vertical = FMath::Max(renderAbove, renderBelow);
+
+	// Get positive corner vector of grid cube containing the unload volume
+	FVector cubeCornerF = FVector(renderDistance + hysteresis, renderDistance + hysteresis, vertical + hysteresis) / gridSize;
+	FIntVector cubeCorner = FIntVector(FMath::CeilToInt(cubeCornerF.X), FMath::CeilToInt(cubeCornerF.Y), FMath::CeilToInt(cubeCornerF.Z));
 
-		// Check for blacklist
-		if (info->blacklisted.Num() != 0)
+	// Get every offset in range
+	streamingOffsets_.Reset();
+	for (int32 z = -cubeCorner.Z; z <= cubeCorner.Z; z++)
+	{
+		for (int32 y = -cubeCorner.Y; y <= cubeCorner.Y; y++)
 		{
-			bool blacklisted = false;
-			for (uint8 d = 0; d < uint8(ETileDirection::TD_MAX); d++)
+			for (int32 x = -cubeCorner.X; x <= cubeCorner.X; x++)
 			{
-				TileInstance *adjacent = tiles_.Find(coord + directions[d]);
+				if (InVolume(FIntVector(x, y, z), hysteresis))
+					streamingOffsets_.Add(FIntVector(x, y, z));
+			}
+		}
+	}
 
-				if (adjacent == nullptr || adjacent->actor == nullptr)
-					continue;
+	// Offsets to load first, then by distance to center
+	streamingOffsets_.StableSort([&](const FIntVector &a, const FIntVector &b)
+	{
+		bool loadA = InVolume(a, 0.0f);
+		bool loadB = InVolume(b, 0.0f);
+		if (loadA != loadB)
+			return loadA;
+		return GridToWorld(a).SizeSquared() < GridToWorld(b).SizeSquared();
+	});
 
-				if (info->blacklisted.Contains(adjacent->info->object))
-				{
-					blacklisted = true;
-					break;
-				}
-			}
-			if (blacklisted)
-				continue;
+	loadOffsetCount_ = 0;
+	while (loadOffsetCount_ < streamingOffsets_.Num() && InVolume(streamingOffsets_[loadOffsetCount_], 0.0f))
+		loadOffsetCount_++;
+}
+
+bool ALibraryGenerator::InVolume(FIntVector offset, float margin)
+{
+	FVector world = GridToWorld(offset);
+	float radius = renderDistance + margin;
+
+	switch (streamingShape)
+	{
+	case EStreamingShape::Ellipsoid:
+	{
+		float height = FMath::Max(renderHeight + margin, 1.0f);
+		return world.SizeSquared2D() / FMath::Square(radius) + FMath::Square(world.Z / height) <= 1.0f;
+	}
+
+	case EStreamingShape::Cylinder:
+		return world.SizeSquared2D() <= FMath::Square(radius) && world.Z <= renderAbove + margin && world.Z >= -(renderBelow + margin);
+
+	default:
+		return world.SizeSquared() <= FMath::Square(radius);
+	}
+}
+
+int32 ALibraryGenerator::FindObserver(FIntVector coord, float margin)
+{
+	for (int32 i = 0; i < observers_.Num(); i++)
+	{
+		if (observers_[i].valid && InVolume(coord - observers_[i].center, margin))
+			return i;
+	}
+	return INDEX_NONE;
+}
+
+float ALibraryGenerator::TilePriority(const FStreamingObserver &observer, FIntVector offset)
+{
+	FVector world = GridToWorld(offset);
+
+	// Distance from where the observer will be, shrunk for tiles in front of the view
+	float facing = FMath::Max(FVector::DotProduct(world.GetSafeNormal(), observer.forward), 0.0f);
+	return FVector::DistSquared(world, observer.ahead) * (1.0f - FMath::Clamp(viewPriorityBias, 0.0f, 0.95f) * facing);
+}
+
+void ALibraryGenerator::TrimLoadedTiles()
+{
+	// Trim a little past the limit so this doesn't run again every time a tile loads
+	int32 target = maxLoadedTiles - maxLoadedTiles / 10;
+
+	// Only tiles kept by hysteresis, tiles in a load volume would be requeued right away
+	TArray<TPair<float, FIntVector>> band;
+	for (const FStreamingObserver &observer : observers_)
+	{
+		for (int32 i = loadOffsetCount_; i < streamingOffsets_.Num(); i++)
+		{
+			FIntVector coord = observer.center + streamingOffsets_[i];
+			if (tiles_.Contains(coord) && FindObserver(coord, 0.0f) == INDEX_NONE)
+				band.Add({ TilePriority(observer, streamingOffsets_[i]), coord });
 		}
+	}
 
-		// Try all tile rotations
-		for (uint8 r = 0; r < uint8(ETileRotation::ROT_MAX); r++)
+	// Least wanted first
+	band.Sort([](const TPair<float, FIntVector> &a, const TPair<float, FIntVector> &b) { return a.Key > b.Key; });
+
+	for (int32 i = 0; i < band.Num() && tiles_.Num() > target; i++)
+		UnloadTile(band[i].Value);
+
+	// Load volumes alone hold more, wait for something to change rather than scanning again every frame
+	if (tiles_.Num() > maxLoadedTiles)
+	{
+		trimStuckTiles_ = tiles_.Num();
+		if (!trimWarned_)
 		{
-			FVector scales[] = { FVector(1, 1, 1), FVector(-1, 1, 1) };
-			uint8 scaleNum = sizeof(scales) / sizeof(scales[0]);
+			UE_LOG(LogLibraryGenerator, Warning, TEXT("Load volumes hold %d tiles, more than maxLoadedTiles (%d)"), tiles_.Num(), maxLoadedTiles);
+			trimWarned_ = true;
+		}
+	}
+	else
+		trimStuckTiles_ = INDEX_NONE;
+}
 
-			// Check if need to mirror
-			if (!info->mirror)
-				scaleNum = 1;
+void ALibraryGenerator::UpdateObservers()
+{
+	// Who to stream around this frame
+	TArray<AActor *> actors;
+	if (streamLocalPlayers)
+	{
+		for (FConstPlayerControllerIterator it = GetWorld()->GetPlayerControllerIterator(); it; ++it)
+		{
+			APlayerController *controller = it->Get();
+			if (controller != nullptr && controller->IsLocalController() && controller->GetPawnOrSpectator() != nullptr)
+				actors.AddUnique(controller->GetPawnOrSpectator());
+		}
+	}
 
-			for (uint8 s = 0; s < scaleNum; s++)
-			{
-				bool valid = true;
+	registeredObservers_.RemoveAll([](const TWeakObjectPtr<AActor> &actor) { return !actor.IsValid(); });
+	for (const TWeakObjectPtr<AActor> &actor : registeredObservers_)
+		actors.AddUnique(actor.Get());
 
-				// Check that in every direction, connections match surrounding tiles
-				for (uint8 d = 0; d < uint8(ETileDirection::TD_MAX); d++)
-				{
-					TileInstance *adjacent = tiles_.Find(coord + directions[d]);
+	// Drop observers that went away, tiles only they kept unload in a full pass
+	int32 removed = observers_.RemoveAll([&](const FStreamingObserver &observer)
+	{
+		return observer.point == INDEX_NONE ? !actors.Contains(observer.actor.Get()) : !interestPoints_.Contains(observer.point);
+	});
+	if (removed > 0)
+		streamingValid_ = false;
 
-					// If this tile hasn't loaded yet, ignore
-					if (adjacent == nullptr)
-						continue;
+	// Add new ones
+	for (AActor *actor : actors)
+	{
+		if (!observers_.ContainsByPredicate([actor](const FStreamingObserver &observer) { return observer.actor.Get() == actor; }))
+			observers_.AddDefaulted_GetRef().actor = actor;
+	}
+	for (const TPair<int32, FVector> &point : interestPoints_)
+	{
+		if (!observers_.ContainsByPredicate([&point](const FStreamingObserver &observer) { return observer.point == point.Key; }))
+			observers_.AddDefaulted_GetRef().point = point.Key;
+	}
+}
 
-					// Get this tile's connection in adjacent's direction
-					ETileConnection connection = GetConnection(info, ETileDirection(d), ETileRotation(r), scales[s]);
+void ALibraryGenerator::UpdateStreaming(FStreamingObserver &observer, FIntVector center)
+{
+	float hysteresis = FMath::Max(unloadHysteresis, 0.0f);
+	FIntVector previous = observer.center;
+	bool moved = observer.valid && streamingValid_;
 
-					// Get connection in this direction from adjacent tile, or empty if adjacent is empty
-					ETileConnection adjacentConnection = ETileConnection::TC_EMPTY;
-					ETileRotation adjacentRotation = ETileRotation(r);
-					FVector adjacentScale = scales[s];
-					if (adjacent->actor != nullptr)
-					{
-						adjacentRotation = ActorTileRotation(adjacent->actor);
-						adjacentScale = adjacent->actor->GetActorScale3D();
-						adjacentConnection = GetConnection(adjacent->info, ReverseDirection(ETileDirection(d)), adjacentRotation, adjacentScale);
-					}
+	observer.center = center;
+	observer.valid = true;
+	trimStuckTiles_ = INDEX_NONE;
 
-					// If the connections don't match or stacked vertically and rotations don't match, stop and don't add this as a possibility
-					bool vertRotCheck = (d == uint8(ETileDirection::TD_ABOVE) || d == uint8(ETileDirection::TD_BELOW)) && connection != ETileConnection::TC_EMPTY && (adjacentRotation != ETileRotation(r) || adjacentScale != scales[s]);
-					if (connection != adjacentConnection || vertRotCheck)
-					{
-						valid = false;
-						break;
-					}
-				}
+	// Only tiles in the old unload volume can have been kept by this observer, unload the ones nobody keeps now
+	if (moved)
+	{
+		for (const FIntVector &offset : streamingOffsets_)
+		{
+			FIntVector coord = previous + offset;
+			if (tiles_.Contains(coord) && FindObserver(coord, hysteresis) == INDEX_NONE)
+				UnloadTile(coord);
+		}
+	}
 
-				// Only add tile if all directions passed
-				if (valid)
-					possibilities.Add({ info, ETileRotation(r), scales[s] });
-			}
+	// Tiers only change within proxyTileDistance of the old or new center
+	if (tieredStreaming)
+	{
+		float reachSquared = FMath::Square(proxyTileDistance + gridSize.GetMax());
+		for (const FIntVector &offset : streamingOffsets_)
+		{
+			if (GridToWorld(offset).SizeSquared() > reachSquared)
+				continue;
 
+			if (moved)
+				UpdateTileTier(previous + offset);
+			UpdateTileTier(center + offset);
 		}
 	}
 
-	// No possible tiles for this space
-	if (possibilities.Num() == 0)
+	// Requeue tiles for the new center
+	observer.queue.Reset();
+	for (int32 i = 0; i < loadOffsetCount_; i++)
 	{
-		// Add empty
-		tiles_.Add(coord, {});
+		FIntVector coord = center + streamingOffsets_[i];
+		if (!tiles_.Contains(coord))
+			observer.queue.Add({ EGenerationTask::Tile, coord, nullptr, TilePriority(observer, streamingOffsets_[i]) });
 	}
-	else
+	observer.queue.Heapify();
+
+	// Shelves keep their place by distance
+	for (FGenerationTask &task : generationQueue_)
+		task.priority = ShelfPriority(task.shelf.Get());
+	generationQueue_.Heapify();
+}
+
+float ALibraryGenerator::ShelfPriority(ABookRow *shelf)
+{
+	if (shelf == nullptr)
+		return 0.0f;
+
+	float nearest = MAX_flt;
+	for (const FStreamingObserver &observer : observers_)
 	{
-		// Add random possibility
-		const RotatedTile &result = possibilities[FMath::RandRange(0, possibilities.Num() - 1)];
-		AddTile(coord, result.rot, result.scale, result.info);
+		if (!observer.valid)
+			continue;
+
+		FVector center = geometryParent != nullptr ? geometryParent->GetActorTransform().TransformPosition(GridToWorld(observer.center)) : GridToWorld(observer.center);
+		nearest = FMath::Min(nearest, FVector::DistSquared(shelf->GetActorLocation(), center));
 	}
+	return nearest != MAX_flt ? nearest : 0.0f;
 }
 
-void ALibraryGenerator::AddTile(FIntVector coord, ETileRotation rotation, FVector scale, const FTileInfo *info)
+void ALibraryGenerator::QueueShelf(ABookRow *shelf)
 {
-	// Spawn actor
-	FVector pos = GridToWorld(coord);
-	FRotator rot(0.0f, rotations[uint8(rotation)], 0.0f);
-	AActor *actor = GetWorld()->SpawnActor(info->object.Get(), &pos, &rot);
-	actor->AttachToActor(geometryParent, { EAttachmentRule::KeepRelative, false });
-	actor->SetActorScale3D(scale);
+	generationQueue_.HeapPush({ EGenerationTask::Shelf, FIntVector::ZeroValue, shelf, ShelfPriority(shelf) });
+	pendingGenerationTasks++;
+}
 
-	// Reset render state after scaling (thanks unreal)
-	actor->SetActorHiddenInGame(true);
-	actor->SetActorHiddenInGame(false);
+void ALibraryGenerator::RegisterObserver(AActor *observer)
+{
+	if (observer != nullptr)
+		registeredObservers_.AddUnique(observer);
+}
 
-	// Add to data structure
-	tiles_.Add(coord, { actor, info });
+void ALibraryGenerator::UnregisterObserver(AActor *observer)
+{
+	registeredObservers_.Remove(observer);
 }
 
-void ALibraryGenerator::UnloadTile(FIntVector coord)
+int32 ALibraryGenerator::AddInterestPoint(FVector location)
 {
-	// Remove from tile map
-	TileInstance tile;
-	tiles_.RemoveAndCopyValue(coord, tile);
+	interestPoints_.Add(nextInterestPoint_, location);
+	return nextInterestPoint_++;
+}
 
-	// Destroy actor
-	if (tile.actor)
-		GetWorld()->DestroyActor(tile.actor);
+void ALibraryGenerator::RemoveInterestPoint(int32 id)
+{
+	interestPoints_.Remove(id);
 }
 
-// Called every frame
-void ALibraryGenerator::Tick(float DeltaTime)
+TArray<FGenerationTask> *ALibraryGenerator::NextGenerationQueue(bool tilesOnly, const TBitArray<> *waiting)
 {
-	Super::Tick(DeltaTime);
+	// Observers take turns so one moving fast can't starve the others
+	int32 turn = INDEX_NONE;
+	for (int32 i = 0; i < observers_.Num() && turn == INDEX_NONE; i++)
+	{
+		int32 index = (nextObserver_ + i) % observers_.Num();
+		if (observers_[index].queue.Num() > 0 && (waiting == nullptr || !(*waiting)[index]))
+			turn = index;
+	}
 
-	// Get player position
-	FVector playerPosF = UGameplayStatics::GetPlayerPawn(GetWorld(), 0)->GetActorLocation();
-	FIntVector playerPos = WorldToGrid(playerPosF);
+	if (!tilesOnly && generationQueue_.Num() > 0 && (turn == INDEX_NONE || generationQueue_.HeapTop().priority < observers_[turn].queue.HeapTop().priority))
+		return &generationQueue_;
 
-	// Get positive corner vector of grid cube to check tiles in
-	FVector cubeCornerF = FVector(renderDistance) / gridSize;
-	FIntVector cubeCorner = FIntVector(FMath::CeilToInt(cubeCornerF.X), FMath::CeilToInt(cubeCornerF.Y), FMath::CeilToInt(cubeCornerF.Z));
+	if (turn == INDEX_NONE)
+		return nullptr;
+
+	nextObserver_ = (turn + 1) % observers_.Num();
+	return &observers_[turn].queue;
+}
+
+void ALibraryGenerator::RunGenerationTasks()
+{
+	double start = FPlatformTime::Seconds();
+	double budget = generationBudgetMs / 1000.0;
+	int32 ran = 0;
 
-	// List of coordinates to generate tiles in
-	TArray<FIntVector> coordsToLoad;
+	if (asyncSolving)
+		StartSolveBatch();
 
-	// Get coords to load
-	for (int32 z = playerPos.Z - cubeCorner.Z; z <= playerPos.Z + cubeCorner.Z; z++)
+	// Observers whose nearest tile waits for a solve batch
+	TBitArray<> waiting(false, observers_.Num());
+
+	// Always make some progress, then stop when out of time
+	while (ran == 0 || FPlatformTime::Seconds() - start < budget)
 	{
-		for (int32 y = playerPos.Y - cubeCorner.Y; y <= playerPos.Y + cubeCorner.Y; y++)
+		// Spawn tiles solved off thread first, they are the nearest
+		if (asyncSolving && ApplySolveResult())
 		{
-			for (int32 x = playerPos.X - cubeCorner.X; x <= playerPos.X + cubeCorner.X; x++)
-			{
-				FIntVector current(x, y, z);
-				TileInstance *tile = tiles_.Find(current);
+			ran++;
+			continue;
+		}
 
-				// If in range
-				if (FVector::Distance(GridToWorld(current), playerPosF) <= renderDistance)
-				{
-					// Add to load list
-					if (tile == nullptr)
-						coordsToLoad.Add(current);
-				}
-				else
+		TArray<FGenerationTask> *queue = NextGenerationQueue(false, &waiting);
+		if (queue == nullptr)
+			break;
+
+		// Remaining tiles wait for the next solve batch, unless they can come from the cache. Other observers and
+		// shelves still get the budget
+		if (asyncSolving && queue->HeapTop().type == EGenerationTask::Tile && !tileCache_.Contains(queue->HeapTop().coord))
+		{
+			int32 observer = observers_.IndexOfByPredicate([queue](const FStreamingObserver &candidate) { return &candidate.queue == queue; });
+			if (observer == INDEX_NONE)
+				break;
+
+			waiting[observer] = true;
+			continue;
+		}
+
+		FGenerationTask task;
+		queue->HeapPop(task, false);
+
+		if (task.type == EGenerationTask::Tile)
+		{
+			// May have been generated directly or for another observer since queued
+			if (tiles_.Contains(task.coord))
+				continue;
+
+			GenerateTile(task.coord);
+		}
+		else
+		{
+			// Shelf was unloaded
+			ABookRow *shelf = task.shelf.Get();
+			if (shelf == nullptr)
+				continue;
+
+			// Requeue until full
+			if (shelf->GenerateBooksStep())
+				generationQueue_.HeapPush(task);
+		}
+		ran++;
+	}
+
+	if (asyncSolving)
+		StartSolveBatch();
+
+	lastGenerationMs = float((FPlatformTime::Seconds() - start) * 1000.0);
+	lastGenerationTasks = ran;
+	pendingGenerationTasks = generationQueue_.Num();
+	for (const FStreamingObserver &observer : observers_)
+		pendingGenerationTasks += observer.queue.Num();
+}
+
+void ALibraryGenerator::StartSolveBatch()
+{
+	// One batch at a time, and only once its results are all in the world so the next snapshot sees them
+	if (solveBatch_.IsValid())
+	{
+		if (!solveBatch_->done || !solveBatch_->results.IsEmpty())
+			return;
+		solveBatch_.Reset();
+	}
+
+	UpdateTileRules();
+
+	TSharedPtr<FTileSolveBatch, ESPMode::ThreadSafe> batch = MakeShared<FTileSolveBatch, ESPMode::ThreadSafe>();
+
+	// Take nearest tiles of each observer in turn, setting cached tiles aside
+	TArray<TPair<TArray<FGenerationTask> *, FGenerationTask>> skipped;
+	while (batch->coords.Num() < solveBatchSize)
+	{
+		TArray<FGenerationTask> *queue = NextGenerationQueue(true);
+		if (queue == nullptr)
+			break;
+
+		FGenerationTask task;
+		queue->HeapPop(task, false);
+
+		if (tileCache_.Contains(task.coord))
+			skipped.Add({ queue, task });
+		else if (!tiles_.Contains(task.coord))
+			batch->coords.AddUnique(task.coord);
+	}
+	for (const TPair<TArray<FGenerationTask> *, FGenerationTask> &task : skipped)
+		task.Key->HeapPush(task.Value);
+
+	if (batch->coords.Num() == 0)
+		return;
+
+	// Snapshot loaded neighbors so the task never reads tiles_
+	for (const FIntVector &coord : batch->coords)
+	{
+		for (const FIntVector &direction : directions)
+		{
+			int32 adjacent = tiles_.Find(coord + direction);
+			if (adjacent != FTileRules::VARIANT_UNLOADED)
+				batch->neighbors.Add(coord + direction, adjacent);
+		}
+	}
+
+	batch->rules = rules_;
+	batch->hashed = hashedGeneration;
+	batch->seed = hashedGeneration ? worldSeed : int32(solveRandom_.GetUnsignedInt());
+
+	if (solver == ETileSolver::Chunk)
+	{
+		batch->chunkSize = FIntVector(FMath::Max(chunkSize.X, 1), FMath::Max(chunkSize.Y, 1), FMath::Max(chunkSize.Z, 1));
+		batch->backtrackBudget = chunkBacktrackBudget;
+
+		// Chunks also need loaded and cached cells inside them and on their border
+		TSet<FIntVector> origins;
+		for (const FIntVector &coord : batch->coords)
+			origins.Add(ChunkOrigin(coord));
+
+		for (const FIntVector &origin : origins)
+		{
+			for (int32 z = -1; z <= batch->chunkSize.Z; z++)
+			{
+				for (int32 y = -1; y <= batch->chunkSize.Y; y++)
 				{
-					// Unload
-					if (tile != nullptr)
-						UnloadTile(current);
+					for (int32 x = -1; x <= batch->chunkSize.X; x++)
+					{
+						FIntVector cell = origin + FIntVector(x, y, z);
+						int32 variant = tiles_.Find(cell);
+						if (variant == FTileRules::VARIANT_UNLOADED)
+							variant = tileCache_.Peek(cell);
+						if (variant != FTileRules::VARIANT_UNLOADED)
+							batch->neighbors.Add(cell, variant);
+					}
 				}
+			}
+		}
+	}
+	solveBatch_ = batch;
+
+	Async(EAsyncExecution::ThreadPool, [batch]()
+	{
+		SolveBatch(*batch);
+		batch->done = true;
+	});
+}
 
-				if (debugGridDraw)
-					DrawDebugBox(GetWorld(), GridToWorld(current), gridSize / 2.0f, FColor(0), false, 1/50.0f);
+void ALibraryGenerator::SolveBatch(FTileSolveBatch &batch)
+{
+	FRandomStream random(batch.seed);
+
+	if (batch.chunkSize != FIntVector::ZeroValue)
+	{
+		FTileChunkSolver chunkSolver(*batch.rules);
+		TArray<int32> variants;
+
+		auto known = [&batch](FIntVector cell)
+		{
+			const int32 *variant = batch.neighbors.Find(cell);
+			return variant != nullptr ? *variant : int32(FTileRules::VARIANT_UNLOADED);
+		};
+
+		for (const FIntVector &coord : batch.coords)
+		{
+			if (batch.cancelled)
+				return;
+
+			// Solved with an earlier chunk
+			if (batch.neighbors.Contains(coord))
+				continue;
+
+			// Same chunk layout as ChunkOrigin
+			FIntVector chunk = FloorDivide(coord, batch.chunkSize);
+			FIntVector origin(chunk.X * batch.chunkSize.X, chunk.Y * batch.chunkSize.Y, chunk.Z * batch.chunkSize.Z);
+
+			chunkSolver.Solve(origin, batch.chunkSize, known, batch.hashed ? batch.seed : int32(random.GetUnsignedInt()), batch.hashed, batch.backtrackBudget, variants);
+			if (chunkSolver.conflicts > 0)
+				UE_LOG(LogLibraryGenerator, Verbose, TEXT("%d loaded tiles conflict in chunk at %s"), chunkSolver.conflicts, *origin.ToString());
+
+			// Every new cell is a result, the game thread caches the ones it doesn't need yet
+			for (int32 i = 0; i < variants.Num(); i++)
+			{
+				FIntVector cell = origin + FIntVector(i % batch.chunkSize.X, (i / batch.chunkSize.X) % batch.chunkSize.Y, i / (batch.chunkSize.X * batch.chunkSize.Y));
+				if (batch.neighbors.Contains(cell))
+					continue;
+
+				batch.neighbors.Add(cell, variants[i]);
+				batch.results.Enqueue({ cell, variants[i] });
 			}
 		}
+		return;
+	}
+
+	for (const FIntVector &coord : batch.coords)
+	{
+		if (batch.cancelled)
+			return;
+
+		// Neighbors from the snapshot or solved earlier in this batch
+		int32 neighbors[uint8(ETileDirection::TD_MAX)];
+		for (uint8 d = 0; d < uint8(ETileDirection::TD_MAX); d++)
+		{
+			const int32 *adjacent = batch.neighbors.Find(coord + directions[d]);
+			neighbors[d] = adjacent != nullptr ? *adjacent : FTileRules::VARIANT_UNLOADED;
+		}
+
+		uint32 roll = batch.hashed ? FTileRules::HashCoord(batch.seed, coord) : random.GetUnsignedInt();
+		int32 variant = batch.rules->Solve(neighbors, coord == FIntVector(0, 0, 0), roll);
+		batch.neighbors.Add(coord, variant);
+		batch.results.Enqueue({ coord, variant });
+	}
+}
+
+bool ALibraryGenerator::ApplySolveResult()
+{
+	FTileSolveResult result;
+	if (!solveBatch_.IsValid() || !solveBatch_->results.Dequeue(result))
+		return false;
+
+	// Rules were recompiled, everything is requeued already
+	if (solveBatch_->rules.Get() != &rules_.Get())
+		return true;
+
+	// Already loaded
+	if (tiles_.Contains(result.coord))
+		return true;
+
+	// Observers moved away, or the rest of a solved chunk
+	int32 observer = FindObserver(result.coord, 0.0f);
+	if (observer == INDEX_NONE)
+	{
+		if (solveBatch_->chunkSize != FIntVector::ZeroValue && !tileCache_.Contains(result.coord))
+		{
+			tileCache_.SetCapacityBytes(TileCacheCapacity());
+			tileCache_.Store(result.coord, result.variant);
+			tileCacheUsedBytes = tileCache_.GetUsedBytes();
+		}
+		return true;
 	}
 
-	// Sort by distance to player
-	coordsToLoad.Sort([&, playerPosF](const FIntVector &a, const FIntVector &b) { return FVector::Distance(playerPosF, GridToWorld(a)) < FVector::Distance(playerPosF, GridToWorld(b)); });
+	int32 neighbors[uint8(ETileDirection::TD_MAX)];
+	GetNeighbors(result.coord, neighbors);
+	bool spawn = result.coord == FIntVector(0, 0, 0);
+
+	// Holes were decided against the snapshot too. Solve the one cell against its neighbors now rather than
+	// requeueing, a chunk solve could leave the same hole again
+	if (result.variant == FTileRules::VARIANT_EMPTY)
+	{
+		uint32 roll = hashedGeneration ? FTileRules::HashCoord(worldSeed, result.coord) : solveRandom_.GetUnsignedInt();
+		int32 candidates;
+		int32 variant = rules_->Solve(neighbors, spawn, roll, &candidates);
+		FTomeStats::solves++;
+		FTomeStats::solveCandidates += candidates;
+
+		if (variant == FTileRules::VARIANT_EMPTY)
+			tiles_.Add(result.coord, FTileRules::VARIANT_EMPTY);
+		else
+			AddTile(result.coord, variant);
+		return true;
+	}
 
-	// Load valid tiles in sorted order
-	for (const FIntVector &coord : coordsToLoad)
+	// Tiles generated directly since the snapshot could conflict, solve again if so
+	if (!rules_->Fits(result.variant, neighbors, spawn))
 	{
-		GenerateTile(coord);
+		FStreamingObserver &nearest = observers_[observer];
+		nearest.queue.HeapPush({ EGenerationTask::Tile, result.coord, nullptr, TilePriority(nearest, result.coord - nearest.center) });
+		return true;
 	}
+
+	AddTile(result.coord, result.variant);
+	return true;
 }
 
+// Called every frame
+void ALibraryGenerator::Tick(float DeltaTime)
+{
+	TOME_SCOPE(GeneratorTick);
+
+	Super::Tick(DeltaTime);
+
+	UpdateObservers();
+	observerCount = observers_.Num();
+	if (observers_.Num() == 0)
+		return;
+
+	UpdateStreamingOffsets();
+
+	// Redraw everything if tiers changed
+	FVector tiers(tieredStreaming ? 1.0f : 0.0f, fullTileDistance, proxyTileDistance);
+	if (tiers != streamingTiers_)
+	{
+		streamingTiers_ = tiers;
+		streamingValid_ = false;
+	}
+
+	// Only stream around observers that changed cell, or all of them when settings change
+	for (FStreamingObserver &observer : observers_)
+	{
+		FVector location;
+		FVector velocity = FVector::ZeroVector;
+		FVector forward = FVector::ZeroVector;
+
+		if (AActor *actor = observer.actor.Get())
+		{
+			APawn *pawn = Cast<APawn>(actor);
+			location = actor->GetActorLocation();
+			velocity = actor->GetVelocity();
+			forward = pawn != nullptr ? pawn->GetViewRotation().Vector() : actor->GetActorForwardVector();
+		}
+		else
+			location = interestPoints_[observer.point];
+
+		FIntVector center = WorldToGrid(location);
+		if (streamingValid_ && observer.valid && center == observer.center)
+			continue;
+
+		// Order new tiles by where the observer is heading, from the center cell
+		FVector ahead = velocity * FMath::Max(streamingLookahead, 0.0f);
+		observer.ahead = location - GridToWorld(center) + ahead.GetClampedToMaxSize(renderDistance);
+		observer.forward = forward;
+
+		UpdateStreaming(observer, center);
+	}
+
+	// Settings changed or an observer left, check every tile
+	if (!streamingValid_)
+	{
+		float hysteresis = FMath::Max(unloadHysteresis, 0.0f);
+		TArray<FIntVector> loaded;
+		tiles_.GetCoords(loaded);
+		for (const FIntVector &coord : loaded)
+		{
+			if (FindObserver(coord, hysteresis) == INDEX_NONE)
+				UnloadTile(coord);
+			else
+				UpdateTileTier(coord);
+		}
+		streamingValid_ = true;
+		trimStuckTiles_ = INDEX_NONE;
+	}
+
+	RunGenerationTasks();
+
+	if (maxLoadedTiles > 0 && tiles_.Num() > maxLoadedTiles && tiles_.Num() != trimStuckTiles_)
+		TrimLoadedTiles();
+
+	if (dirtyFarChunks_.Num() > 0)
+		RebuildFarChunks();
+
+	loadedTiles = tiles_.Num();
+	FTomeStats::loadedTiles = loadedTiles;
+	tileGridUsedBytes = tiles_.GetUsedBytes();
+
+	if (debugGridDraw)
+	{
+		TArray<FIntVector> loaded;
+		tiles_.GetCoords(loaded);
+		for (const FIntVector &coord : loaded)
+			DrawDebugBox(GetWorld(), GridToWorld(coord), gridSize / 2.0f, FColor(0), false, 1/50.0f);
+	}
+}
@@ -6,91 +6,138 @@
 #include "GameFramework/Actor.h"
 #include "Engine/World.h"
 #include "Engine/DataTable.h"
+#include "TileRules.h"
+#include "TileCache.h"
+#include "TileGrid.h"
+#include "TileChunkSolver.h"
 #include "Kismet/GameplayStatics.h"
 #include "Math/UnrealMathUtility.h"
 #include "DrawDebugHelpers.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Containers/Queue.h"
 #include "LibraryGenerator.generated.h"
 
-// Amounts tiles can be rotated on the z-axis
-UENUM(BlueprintType)
-enum class ETileRotation : uint8
+class ABookRow;
+
+// Tile solved on a worker thread
+struct FTileSolveResult
 {
-	ROT_0   UMETA(DisplayName = "0"),
-	ROT_90  UMETA(DisplayName = "90"),
-	ROT_180 UMETA(DisplayName = "180"),
-	ROT_270 UMETA(DisplayName = "270"),
+	FIntVector coord;
+	int32 variant;
+};
 
-	ROT_MAX UMETA(Hidden)
+// Tiles to solve off the game thread, shared between the game thread and the solve task
+struct FTileSolveBatch
+{
+	TSharedPtr<const FTileRules, ESPMode::ThreadSafe> rules;
+	TArray<FIntVector> coords; // Nearest first
+	TMap<FIntVector, int32> neighbors; // Variants of loaded tiles around coords when the batch started
+	int32 seed = 0;
+	bool hashed = false; // Roll from coordinate hash of seed instead of a stream
+	FIntVector chunkSize = FIntVector::ZeroValue; // Solve whole chunks around coords if not zero
+	int32 backtrackBudget = 0;
+
+	TQueue<FTileSolveResult, EQueueMode::Spsc> results;
+	FThreadSafeBool cancelled;
+	FThreadSafeBool done;
 };
 
-// Directions tiles are connected
-UENUM(BlueprintType)
-enum class ETileDirection : uint8
+// Static mesh of a tile blueprint drawn through a shared instanced component
+struct FTileMeshPart
 {
-	TD_LEFT  UMETA(DisplayName = "Left"),
-	TD_RIGHT UMETA(DisplayName = "Right"),
-	TD_BACK  UMETA(DisplayName = "Back"),
-	TD_FRONT UMETA(DisplayName = "Front"),
-	TD_BELOW UMETA(DisplayName = "Below"),
-	TD_ABOVE UMETA(DisplayName = "Above"),
-
-	TD_MAX   UMETA(Hidden)
+	int32 component; // Index into instanced components
+	FTransform relative; // Transform relative to the tile actor
 };
 
+// How a tile blueprint is drawn in instanced mode
+struct FTileClassMeshes
+{
+	TArray<FTileMeshPart> parts;
+	bool interactive = false; // Has more than static meshes, needs a full actor
+};
+
+// Instance added for a tile
+struct FTileMeshInstance
+{
+	int32 component;
+	int32 instance;
+};
 
-// Possible connection types (must match adjacent to generate)
+// How tiles are picked
 UENUM(BlueprintType)
-enum class ETileConnection : uint8
+enum class ETileSolver : uint8
 {
-	TC_EMPTY                UMETA(DisplayName = "Empty"),
-	TC_PATH                 UMETA(DisplayName = "Path"),
-	TC_PATH_STAIRS_TOP      UMETA(DisplayName = "PathStairsTop"),
-	TC_PATH_STAIRS_TURN_TOP UMETA(DisplayName = "PathStairsTurnTop"),
+	Greedy UMETA(ToolTip = "One tile at a time from its loaded neighbors, leaving empty space when nothing fits"),
+	Chunk  UMETA(ToolTip = "A chunk at a time with propagation and backtracking, fewer holes but more work per solve"),
+};
 
-	TC_MAX                  UMETA(Hidden)
+// Shape of the volume tiles are loaded in around the player
+UENUM(BlueprintType)
+enum class EStreamingShape : uint8
+{
+	Sphere    UMETA(ToolTip = "renderDistance in every direction"),
+	Ellipsoid UMETA(ToolTip = "renderDistance horizontally, renderHeight vertically"),
+	Cylinder  UMETA(ToolTip = "renderDistance horizontally, renderAbove up and renderBelow down"),
 };
 
-// Row from tile connections data table
-USTRUCT(BlueprintType)
-struct FTileInfo : public FTableRowBase
+// How a loaded tile is drawn in tiered streaming, by distance to the nearest observer
+enum class ETileTier : uint8
 {
-	GENERATED_BODY()
+	Full,  // Tile blueprint (or its instances)
+	Proxy, // Proxy mesh instance per tile
+	Far,   // Proxy meshes batched per far chunk
+};
 
-public:
-	// Blueprint associated with this tile
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	TSubclassOf<AActor> object;
+// Components drawing the far tier tiles of a chunk
+struct FFarChunk
+{
+	TMap<TPair<UStaticMesh *, bool>, UInstancedStaticMeshComponent *> components; // By proxy mesh and mirror
+};
 
-	// Whether this tile should sometimes generate mirrored
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	bool mirror;
+// Kinds of work the generator spreads over frames
+enum class EGenerationTask : uint8
+{
+	Tile,  // Solve and spawn a tile
+	Shelf, // Add a group of books to a shelf
+};
 
-	// Whether the player can spawn on this tile
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	bool canSpawnOn;
+// Queued unit of generation work
+struct FGenerationTask
+{
+	EGenerationTask type;
+	FIntVector coord; // Tile to generate
+	TWeakObjectPtr<ABookRow> shelf; // Shelf to fill
+	float priority; // Squared distance to streaming center (biased ahead for tiles), lowest first
 
-	// Tiles to not generate adjacent to this tile
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	TArray<TSubclassOf<AActor>> blacklisted;
+	bool operator<(const FGenerationTask &other) const { return priority < other.priority; }
+};
 
-	// Array of connections for this tile
-	UPROPERTY(EditAnywhere)
-	ETileConnection connections[uint8(ETileDirection::TD_MAX)];
+// How an actor on a parked tile was before parking, put back when the tile is reused
+struct FParkedActorState
+{
+	TWeakObjectPtr<AActor> actor;
+	bool hidden;
+	bool collision;
+	bool tick;
 };
 
-// Active tile instantiated in the world
-struct TileInstance
+// Tile actor waiting in the pool
+struct FParkedTile
 {
-	AActor *actor = nullptr; // If null, empty space
-	const FTileInfo *info = nullptr; // Pointer to entry in data table
+	AActor *actor;
+	TArray<FParkedActorState> states; // The tile and everything attached to it
 };
 
-// Used internally to keep track of tiles to generate
-struct RotatedTile
+// Something tiles are streamed around: a local player, a registered actor or an interest point
+struct FStreamingObserver
 {
-	const FTileInfo *info;
-	ETileRotation rot;
-	FVector scale;
+	TWeakObjectPtr<AActor> actor; // Followed actor, null for interest points
+	int32 point = INDEX_NONE; // Interest point id
+	FIntVector center; // Cell streamed around
+	bool valid = false; // Whether tiles around center are queued
+	FVector ahead = FVector::ZeroVector; // Expected position relative to the center cell
+	FVector forward = FVector::ZeroVector; // View direction
+	TArray<FGenerationTask> queue; // Heap of tiles to load around center
 };
 
 UCLASS()
@@ -109,6 +156,9 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	// Called when the game ends or when destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 private:
 	// Convert world coordinates to grid coordinates
 	UFUNCTION(BlueprintCallable)
@@ -145,19 +195,150 @@ private:
 	UFUNCTION(BlueprintCallable)
 	int32 PositiveMod(int32 value, int32 mod);
 
+	// Compile tile data into rules if it changed since last compile
+	void UpdateTileRules();
+
 	// Creates a suitable tile in the given position
 	UFUNCTION(BlueprintCallable)
 	void GenerateTile(FIntVector coord);
 
-	// Adds a tile to the world
-	void AddTile(FIntVector coord, ETileRotation direction, FVector scale, const FTileInfo *info);
+	// Get variants of loaded tiles around a position
+	void GetNeighbors(FIntVector coord, int32 outNeighbors[uint8(ETileDirection::TD_MAX)]);
+
+	// Add the tile remembered for a position if it still fits. Returns false if none or it doesn't fit
+	bool LoadCachedTile(FIntVector coord, const int32 neighbors[uint8(ETileDirection::TD_MAX)]);
+
+	// Solve the chunk around a position, caching cells that aren't loaded or cached yet. Returns the variant at coord
+	int32 SolveChunk(FIntVector coord);
+
+	// First cell of the chunk containing a position
+	FIntVector ChunkOrigin(FIntVector coord) const;
+
+	// Memory the tile cache may use. Chunk mode keeps the rest of each solved chunk there, so it always holds a few
+	// chunks no matter how small tileCacheBytes is
+	int32 TileCacheCapacity() const;
+
+	// Adds a tile variant to the world, drawn for its tier
+	void AddTile(FIntVector coord, int32 variant);
 
 	// Remove a tile from the world
 	UFUNCTION(BlueprintCallable)
 	void UnloadTile(FIntVector coord);
 
+	// Remove whatever draws a loaded cell (actor, instances or far chunk entry)
+	void RemoveTileDrawing(FIntVector coord, int32 variant, uint32 flags);
+
+	// Tier a cell should be drawn with, from distance to the nearest observer
+	ETileTier GetTileTier(FIntVector coord);
+
+	// Redraw a loaded cell if its tier changed
+	void UpdateTileTier(FIntVector coord);
+
+	// Far chunk containing a cell
+	FIntVector FarChunkCoord(FIntVector coord) const;
+
+	// Rebuild instances of far chunks whose tiles changed
+	void RebuildFarChunks();
+
+	// Get a parked tile actor for a class and mirror, shown as it was before parking, or null
+	AActor *TakePooledTile(UClass *type, bool mirrored);
+
+	// Park a tile actor for reuse, destroying it if the pool is full
+	void ReleaseTile(AActor *actor, bool mirrored);
+
+	// Hide a tile and everything attached to it, disabling collision and tick, and remember how they were
+	void ParkTile(AActor *actor, TArray<FParkedActorState> &outStates);
+
+	// Put parked actors back the way they were
+	void UnparkTile(const TArray<FParkedActorState> &states);
+
+	// Get (and build on first use) how a tile blueprint is drawn with instances
+	const FTileClassMeshes &GetTileMeshes(UClass *type, bool mirrored);
+
+	// Get instanced component for a mesh and materials, creating if needed
+	int32 GetInstanceComponent(UStaticMeshComponent *source, bool mirrored);
+
+	// Get instanced component for a proxy mesh, creating if needed
+	int32 GetProxyComponent(UStaticMesh *mesh, bool mirrored);
+
+	// Add an instance to a shared component, reusing a parked one if possible
+	int32 AddInstance(int32 component, const FTransform &transform);
+
+	// Add instances for a non-interactive tile. Returns false if the tile needs an actor
+	bool AddTileInstances(FIntVector coord, const FTileVariant &tile, const FTransform &transform);
+
+	// Park the instances of a tile for reuse
+	void RemoveTileInstances(FIntVector coord);
+
+	// Rebuild sorted streaming offsets if the streaming shape, its extents, hysteresis or grid size changed
+	void UpdateStreamingOffsets();
+
+	// Whether a grid offset from the center cell is inside the streaming shape grown by margin
+	bool InVolume(FIntVector offset, float margin);
+
+	// Index of the first observer whose streaming shape grown by margin contains a cell, or INDEX_NONE
+	int32 FindObserver(FIntVector coord, float margin);
+
+	// Load priority of a grid offset from an observer's cell, lower is sooner. Favors where it is heading and looking
+	float TilePriority(const FStreamingObserver &observer, FIntVector offset);
+
+	// Unload tiles in hysteresis bands, behind observers first, until under maxLoadedTiles
+	void TrimLoadedTiles();
+
+	// Match observers to local players, registered actors and interest points
+	void UpdateObservers();
+
+	// Move an observer, unloading tiles no observer keeps anymore and queueing new ones nearest first
+	void UpdateStreaming(FStreamingObserver &observer, FIntVector center);
+
+	// Squared distance of a shelf to the nearest observer
+	float ShelfPriority(ABookRow *shelf);
+
+	// Queue to run next: observers' tile queues take turns, shelves go first when nearer. Null if all empty.
+	// Observers set in waiting are passed over
+	TArray<FGenerationTask> *NextGenerationQueue(bool tilesOnly, const TBitArray<> *waiting = nullptr);
+
+	// Run queued tasks, nearest first, until the frame budget is spent
+	void RunGenerationTasks();
+
+	// Take the nearest queued tiles and solve them on a worker thread
+	void StartSolveBatch();
+
+	// Spawn one tile solved off thread. Returns false if none are ready
+	bool ApplySolveResult();
+
+	// Solve a batch in order, runs on a worker thread
+	static void SolveBatch(FTileSolveBatch &batch);
+
 
 public:
+	// Queue a shelf to have its books added over the next frames (see ABookRow::BeginGenerateBooks)
+	void QueueShelf(ABookRow *shelf);
+
+	// Recompile tile rules from tileData (call after editing the table at runtime)
+	UFUNCTION(BlueprintCallable)
+	void CompileTileRules();
+
+	// Stream tiles around an actor too (e.g. a spectator camera), local players are followed already
+	UFUNCTION(BlueprintCallable)
+	void RegisterObserver(AActor *observer);
+
+	// Stop streaming around a registered actor
+	UFUNCTION(BlueprintCallable)
+	void UnregisterObserver(AActor *observer);
+
+	// Stream tiles around a fixed location. Returns an id for RemoveInterestPoint
+	UFUNCTION(BlueprintCallable)
+	int32 AddInterestPoint(FVector location);
+
+	// Stop streaming around an interest point
+	UFUNCTION(BlueprintCallable)
+	void RemoveInterestPoint(int32 id);
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent &PropertyChangedEvent) override;
+#endif
+
 	// Data table of tile connection data
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	UDataTable *tileData;
@@ -170,17 +351,263 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	float renderDistance = 10000;
 
+	// Stream around every local player's pawn (or spectator), not just registered observers and interest points
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool streamLocalPlayers = true;
+
+	// Observers tiles were streamed around last frame
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly)
+	int32 observerCount = 0;
+
+	// Shape of the volume tiles are loaded in
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	EStreamingShape streamingShape = EStreamingShape::Sphere;
+
+	// Vertical radius of the ellipsoid shape
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "streamingShape == EStreamingShape::Ellipsoid"))
+	float renderHeight = 4000;
+
+	// Distance above the player loaded with the cylinder shape
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "streamingShape == EStreamingShape::Cylinder"))
+	float renderAbove = 3000;
+
+	// Distance below the player loaded with the cylinder shape
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "streamingShape == EStreamingShape::Cylinder"))
+	float renderBelow = 3000;
+
+	// Seconds of player movement to look ahead when ordering tiles to load (capped at renderDistance)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float streamingLookahead = 1.0f;
+
+	// How much tiles in view load before tiles to the side and behind (0 = only distance matters)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", ClampMax = "0.95"))
+	float viewPriorityBias = 0.5f;
+
+	// Loaded cells above which tiles kept by unloadHysteresis are unloaded early, behind the player first (0 = no limit)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 maxLoadedTiles = 0;
+
 	// Size of each tile
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	FVector gridSize = FVector(2000, 2000, 1000);
 
+	// Extra distance past renderDistance before tiles unload (stops edge tiles reloading when moving back and forth)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float unloadHysteresis = 1000;
+
+	// Milliseconds per frame to spend generating tiles and shelves (at least one task always runs)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float generationBudgetMs = 4.0f;
+
+	// Whether BookRows in the world fill their shelves through the generation queue
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool budgetShelfGeneration = true;
+
+	// Milliseconds spent generating last frame
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly)
+	float lastGenerationMs = 0.0f;
+
+	// Tasks run last frame
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly)
+	int32 lastGenerationTasks = 0;
+
+	// Tasks waiting in queue
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly)
+	int32 pendingGenerationTasks = 0;
+
+	// Max unloaded tile actors kept for reuse per tile blueprint (and mirror)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 tilePoolCapacity = 32;
+
+	// Tiles reused from the pool
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly)
+	int32 tilePoolHits = 0;
+
+	// Tiles spawned because the pool had none
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly)
+	int32 tilePoolMisses = 0;
+
+	// Tiles destroyed because the pool was full
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly)
+	int32 tilePoolEvictions = 0;
+
+	// Draw tiles without interactive parts as instances in shared components instead of spawning actors
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool instancedRendering = false;
+
+	// Draw far tiles as their proxy mesh (see FTileInfo::proxyMesh) so renderDistance can go further for the same cost
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool tieredStreaming = false;
+
+	// Distance within tiles get their full blueprint in tiered streaming
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "tieredStreaming"))
+	float fullTileDistance = 6000;
+
+	// Distance within tiles get a proxy instance each in tiered streaming, past it proxies are batched per far chunk
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "tieredStreaming"))
+	float proxyTileDistance = 12000;
+
+	// Cells batched into one set of components in the far tier (set before play)
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "tieredStreaming"))
+	FIntVector farChunkSize = FIntVector(8, 8, 4);
+
+	// Far chunks drawing tiles
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly)
+	int32 farChunkCount = 0;
+
+	// Solve tiles on worker threads, the game thread only spawns them
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool asyncSolving = false;
+
+	// Tiles solved per worker task
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 solveBatchSize = 64;
+
+	// Pick tiles from a hash of worldSeed and the coordinate, so a cell with the same neighbors always gets the same tile
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool hashedGeneration = false;
+
+	// Seed for hashedGeneration
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 worldSeed = 0;
+
+	// How tiles are picked
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	ETileSolver solver = ETileSolver::Greedy;
+
+	// Cells solved together in chunk mode
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "solver == ETileSolver::Chunk"))
+	FIntVector chunkSize = FIntVector(8, 8, 4);
+
+	// Decisions undone per chunk before giving up and leaving holes
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "solver == ETileSolver::Chunk"))
+	int32 chunkBacktrackBudget = 64;
+
+	// Decisions undone in the last chunk solved on the game thread
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly)
+	int32 lastChunkBacktracks = 0;
+
+	// Cells left empty in the last chunk solved on the game thread because nothing fit
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly)
+	int32 lastChunkHoles = 0;
+
+	// Loaded tiles in the last chunk solved on the game thread that didn't fit their loaded neighbors (kept as loaded)
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly)
+	int32 lastChunkConflicts = 0;
+
+	// Memory for remembering unloaded tiles, so they come back the same without solving (raised to fit a few chunks in
+	// chunk mode)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 tileCacheBytes = 4 * 1024 * 1024;
+
+	// Tiles reloaded from the cache
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly)
+	int32 tileCacheHits = 0;
+
+	// Memory the tile cache is using
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly)
+	int32 tileCacheUsedBytes = 0;
+
+	// Cells loaded (including empty space)
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly)
+	int32 loadedTiles = 0;
+
+	// Memory the loaded cell grid is using
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly)
+	int32 tileGridUsedBytes = 0;
+
 	// Draw debug grid?
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	bool debugGridDraw = false;
 
 private:
-	// Active tiles in the world
-	TMap<FIntVector, TileInstance> tiles_;
+	// Variants of loaded cells
+	FTileGrid tiles_;
+
+	// Actors of loaded tiles that aren't empty or drawn with instances
+	TMap<FIntVector, AActor *> tileActors_;
+
+	// Tile data compiled for candidate lookups (shared with solve tasks)
+	TSharedRef<FTileRules, ESPMode::ThreadSafe> rules_ = MakeShared<FTileRules, ESPMode::ThreadSafe>();
+
+	// Unloaded tiles
+	FTileCache tileCache_;
+
+	// Random stream for solving on the game thread
+	FRandomStream solveRandom_;
+
+	// Batch being solved off thread, or its results waiting to spawn
+	TSharedPtr<FTileSolveBatch, ESPMode::ThreadSafe> solveBatch_;
+
+	// Grid offsets within the unload volume, ones to load first, each part sorted by distance to center
+	TArray<FIntVector> streamingOffsets_;
+
+	// Number of offsets at the start of streamingOffsets_ within the load volume
+	int32 loadOffsetCount_ = 0;
+
+	// Settings streamingOffsets_ was built with
+	EStreamingShape offsetsShape_ = EStreamingShape::Sphere;
+	FVector offsetsExtents_ = FVector::ZeroVector; // renderDistance, renderHeight, renderAbove
+	float offsetsBelow_ = -1.0f;
+	float offsetsHysteresis_ = -1.0f;
+	FVector offsetsGridSize_ = FVector::ZeroVector;
+
+	// Everything tiles are streamed around
+	TArray<FStreamingObserver> observers_;
+
+	// Observer whose tiles go next
+	int32 nextObserver_ = 0;
+
+	// Actors streamed around besides local players
+	TArray<TWeakObjectPtr<AActor>> registeredObservers_;
+
+	// Fixed locations streamed around, by id
+	TMap<int32, FVector> interestPoints_;
+	int32 nextInterestPoint_ = 0;
+
+	// Whether tiles_ matches observers and offsets (false forces a full pass)
+	bool streamingValid_ = false;
+
+	// Tiles loaded when TrimLoadedTiles last couldn't get under maxLoadedTiles, not trimmed again until the count
+	// or the observers change (INDEX_NONE if it could)
+	int32 trimStuckTiles_ = INDEX_NONE;
+	bool trimWarned_ = false;
+
+	// Parked tile actors by class and mirror (mirrored actors keep their negative scale so render state stays valid)
+	TMap<TPair<UClass *, bool>, TArray<FParkedTile>> tilePool_;
+
+	// Shared components drawing tile meshes in instanced mode
+	UPROPERTY()
+	TArray<UHierarchicalInstancedStaticMeshComponent *> instanceComponents_;
+
+	// Instances parked out of sight for reuse, per component
+	TArray<TArray<int32>> freeInstances_;
+
+	// Component per mesh, materials and mirror
+	TMap<FString, int32> instanceComponentIndices_;
+
+	// Meshes of each tile blueprint, by mirror
+	TMap<TPair<UClass *, bool>, FTileClassMeshes> tileClassMeshes_;
+
+	// Instances of each tile drawn in instanced mode or as a proxy
+	TMap<FIntVector, TArray<FTileMeshInstance>> tileInstances_;
+
+	// Component per proxy mesh and mirror
+	TMap<TPair<UStaticMesh *, bool>, int32> proxyComponentIndices_;
+
+	// Far tier drawing by chunk, and chunks to rebuild
+	TMap<FIntVector, FFarChunk> farChunks_;
+	TSet<FIntVector> dirtyFarChunks_;
+
+	// Components of far chunks
+	UPROPERTY()
+	TArray<UInstancedStaticMeshComponent *> farComponents_;
+
+	// Tier settings tiles were drawn with (enabled, full and proxy distance)
+	FVector streamingTiers_ = FVector::ZeroVector;
+
+	// Heap of shelves to fill over frames (tiles are queued per observer)
+	TArray<FGenerationTask> generationQueue_;
 
 	// Corresponds to ETileDirection
 	static const FIntVector directions[uint8(ETileDirection::TD_MAX)];
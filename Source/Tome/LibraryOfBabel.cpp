@@ -2,5 +2,279 @@
 
 #include "LibraryOfBabel.h"
 #include "Modules/ModuleManager.h"
+#include "Containers/Ticker.h"
+#include "BookText.h"
+#include "TomeStats.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, Tome, "Tome" );
+class FTomeModule : public FDefaultGameModuleImpl
+{
+public:
+	virtual void StartupModule() override
+	{
+		// Publish counters once a frame
+		statsTicker_ = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&FTomeStats::Publish));
+	}
+
+	virtual void ShutdownModule() override
+	{
+		FTicker::GetCoreTicker().RemoveTicker(statsTicker_);
+	}
+
+private:
+	FDelegateHandle statsTicker_;
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FTomeModule, Tome, "Tome" );
+
+// Six base 29 digits fit in a limb, pages are read and written six symbols at a time
+static const int32 digitsPerGroup = 6;
+static const uint32 groupBase = 29u * 29u * 29u * 29u * 29u * 29u;
+
+// Six base 36 digits for hexagon names
+static const uint32 hexagonBase = 36u * 36u * 36u * 36u * 36u * 36u;
+
+static const uint32 pagesPerHexagon = FLibraryOfBabel::walls * FLibraryOfBabel::shelves * FLibraryOfBabel::volumes * FLibraryOfBabel::pages;
+
+static_assert(FLibraryOfBabel::pageLength % digitsPerGroup == 0, "Pages are converted in whole groups");
+static_assert(FLibraryOfBabel::pageLength % FBookText::symbolsPerWord == 0, "Pages are unpacked in whole words");
+static_assert(FLibraryOfBabel::pageLength * 4.858 < FBabelNumber::bitCount, "Pages must fit in a number");
+
+// Rounds of multiply, add and xorshift over the bits needed for 29^pageLength, numbers past it walk the cycle until
+// they land back under it
+struct FBabelPermutation
+{
+	static const int32 rounds = 4;
+
+	FBabelPermutation()
+	{
+		count = FBabelNumber(1);
+		for (int32 i = 0; i < FLibraryOfBabel::pageLength / digitsPerGroup; i++)
+			count.MultiplyAdd(groupBase, 0);
+
+		FBabelNumber last = count;
+		last.Subtract(FBabelNumber(1));
+		bits = last.BitLength();
+
+		// Shifting by at least half the bits makes the xorshift its own inverse
+		shift = (bits + 1) / 2;
+
+		// Fixed constants so every build agrees on the library
+		uint64 key = 0x4241424C4C494252ull; // "BABLLIBR"
+		uint64 counter = 0;
+		for (int32 r = 0; r < rounds; r++)
+		{
+			for (int32 i = 0; i < FBabelNumber::limbCount; i++)
+			{
+				uint64 random = FBookText::Random(key, counter++);
+				multipliers[r].limbs[i] = uint32(random);
+				increments[r].limbs[i] = uint32(random >> 32);
+			}
+			multipliers[r].Mask(bits);
+			multipliers[r].limbs[0] |= 1;
+			increments[r].Mask(bits);
+			inverses[r] = FBabelNumber::InverseOdd(multipliers[r]);
+			inverses[r].Mask(bits);
+		}
+	}
+
+	FBabelNumber count; // 29^pageLength
+	int32 bits;
+	int32 shift;
+	FBabelNumber multipliers[rounds];
+	FBabelNumber increments[rounds];
+	FBabelNumber inverses[rounds];
+};
+
+static const FBabelPermutation &GetPermutation()
+{
+	static const FBabelPermutation permutation;
+	return permutation;
+}
+
+bool FLibraryOfBabel::GetPage(const FBabelAddress &address, FString &outText, int32 lineSize)
+{
+	FBabelNumber number;
+	if (!AddressToNumber(address, number))
+		return false;
+
+	NumberToText(Permute(number), lineSize, outText);
+	return true;
+}
+
+bool FLibraryOfBabel::FindPage(const FString &text, FBabelAddress &outAddress)
+{
+	FBabelNumber number;
+	if (!TextToNumber(text, number))
+		return false;
+
+	NumberToAddress(Unpermute(number), outAddress);
+	return true;
+}
+
+bool FLibraryOfBabel::AddressToNumber(const FBabelAddress &address, FBabelNumber &outNumber)
+{
+	if (address.wall < 1 || address.wall > walls || address.shelf < 1 || address.shelf > shelves ||
+		address.volume < 1 || address.volume > volumes || address.page < 1 || address.page > pages)
+		return false;
+
+	if (address.hexagon.IsEmpty())
+		return false;
+
+	outNumber = FBabelNumber();
+	for (TCHAR c : address.hexagon)
+	{
+		uint32 digit;
+		if (c >= '0' && c <= '9')
+			digit = c - '0';
+		else if (c >= 'a' && c <= 'z')
+			digit = c - 'a' + 10;
+		else if (c >= 'A' && c <= 'Z')
+			digit = c - 'A' + 10;
+		else
+			return false;
+
+		if (outNumber.MultiplyAdd(36, digit) != 0)
+			return false;
+	}
+
+	uint32 local = ((uint32(address.wall - 1) * shelves + uint32(address.shelf - 1)) * volumes + uint32(address.volume - 1)) * pages + uint32(address.page - 1);
+	if (outNumber.MultiplyAdd(pagesPerHexagon, local) != 0)
+		return false;
+
+	// Past the last page
+	return outNumber < GetPermutation().count;
+}
+
+void FLibraryOfBabel::NumberToAddress(FBabelNumber number, FBabelAddress &outAddress)
+{
+	uint32 local = number.Divide<pagesPerHexagon>();
+	outAddress.page = local % pages + 1;
+	local /= pages;
+	outAddress.volume = local % volumes + 1;
+	local /= volumes;
+	outAddress.shelf = local % shelves + 1;
+	outAddress.wall = local / shelves + 1;
+
+	// Digits come out lowest first
+	static const TCHAR digits[] = TEXT("0123456789abcdefghijklmnopqrstuvwxyz");
+	TArray<TCHAR, TInlineAllocator<512>> reversed;
+	do
+	{
+		uint32 group = number.Divide<hexagonBase>();
+		bool last = number.IsZero();
+		for (int32 i = 0; i < 6 && (!last || group != 0 || i == 0); i++)
+		{
+			reversed.Add(digits[group % 36]);
+			group /= 36;
+		}
+	} while (!number.IsZero());
+
+	outAddress.hexagon.Reset(reversed.Num());
+	for (int32 i = reversed.Num() - 1; i >= 0; i--)
+		outAddress.hexagon.AppendChar(reversed[i]);
+}
+
+bool FLibraryOfBabel::TextToNumber(const FString &text, FBabelNumber &outNumber)
+{
+	// Rest of the page is spaces
+	uint8 symbols[pageLength];
+	FMemory::Memset(symbols, uint8(FBookText::unpunctuatedSize - 1), pageLength);
+
+	int32 length = 0;
+	for (TCHAR c : text)
+	{
+		// Lines are implicit
+		if (c == '\n' || c == '\r')
+			continue;
+
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+
+		const TCHAR *found = FCString::Strchr(FBookText::alphabet, c);
+		if (c == 0 || found == nullptr || length == pageLength)
+			return false;
+
+		symbols[length++] = uint8(found - FBookText::alphabet);
+	}
+
+	// Highest group first
+	outNumber = FBabelNumber();
+	for (int32 group = pageLength / digitsPerGroup - 1; group >= 0; group--)
+	{
+		uint32 value = 0;
+		for (int32 i = digitsPerGroup - 1; i >= 0; i--)
+			value = value * FBookText::alphabetSize + symbols[group * digitsPerGroup + i];
+		outNumber.MultiplyAdd(groupBase, value);
+	}
+	return true;
+}
+
+void FLibraryOfBabel::NumberToText(FBabelNumber number, int32 lineSize, FString &outText)
+{
+	// Pack symbols so the page expands like a book page
+	uint64 packed[pageLength / FBookText::symbolsPerWord] = {};
+	for (int32 group = 0; group < pageLength / digitsPerGroup; group++)
+	{
+		uint32 value = number.Divide<groupBase>();
+		for (int32 i = 0; i < digitsPerGroup; i++)
+		{
+			int32 symbol = group * digitsPerGroup + i;
+			packed[symbol / FBookText::symbolsPerWord] |= uint64(value % FBookText::alphabetSize) << ((symbol % FBookText::symbolsPerWord) * FBookText::packedBits);
+			value /= FBookText::alphabetSize;
+		}
+	}
+
+	int32 outputLength = FBookText::OutputLength(pageLength, lineSize);
+	TArray<TCHAR> &chars = outText.GetCharArray();
+	chars.SetNumUninitialized(outputLength + 1);
+	FBookText::Unpack(packed, pageLength, lineSize, chars.GetData());
+	chars[outputLength] = 0;
+}
+
+FBabelNumber FLibraryOfBabel::Permute(const FBabelNumber &number)
+{
+	const FBabelPermutation &permutation = GetPermutation();
+
+	FBabelNumber result = number;
+	do
+	{
+		for (int32 r = 0; r < FBabelPermutation::rounds; r++)
+		{
+			result = FBabelNumber::MultiplyLow(permutation.multipliers[r], result);
+			result.Add(permutation.increments[r]);
+			result.Mask(permutation.bits);
+			result.XorShiftRight(permutation.shift);
+		}
+	} while (!(result < permutation.count));
+
+	return result;
+}
+
+FBabelNumber FLibraryOfBabel::Unpermute(const FBabelNumber &number)
+{
+	const FBabelPermutation &permutation = GetPermutation();
+
+	FBabelNumber result = number;
+	do
+	{
+		for (int32 r = FBabelPermutation::rounds - 1; r >= 0; r--)
+		{
+			result.XorShiftRight(permutation.shift);
+			result.Subtract(permutation.increments[r]);
+			result = FBabelNumber::MultiplyLow(permutation.inverses[r], result);
+			result.Mask(permutation.bits);
+		}
+	} while (!(result < permutation.count));
+
+	return result;
+}
+
+bool UBabelFunctionLibrary::GetBabelPage(const FBabelAddress &address, FString &text)
+{
+	return FLibraryOfBabel::GetPage(address, text);
+}
+
+bool UBabelFunctionLibrary::FindBabelPage(const FString &text, FBabelAddress &address)
+{
+	return FLibraryOfBabel::FindPage(text, address);
+}
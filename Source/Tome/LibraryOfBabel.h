@@ -3,4 +3,82 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "BabelNumber.h"
+#include "LibraryOfBabel.generated.h"
 
+// Where a page is shelved
+USTRUCT(BlueprintType)
+struct TOME_API FBabelAddress
+{
+	GENERATED_BODY()
+
+	// Base 36 number, digits 0-9 then a-z
+	UPROPERTY(BlueprintReadWrite)
+	FString hexagon = TEXT("0");
+
+	UPROPERTY(BlueprintReadWrite)
+	int32 wall = 1;
+
+	UPROPERTY(BlueprintReadWrite)
+	int32 shelf = 1;
+
+	UPROPERTY(BlueprintReadWrite)
+	int32 volume = 1;
+
+	UPROPERTY(BlueprintReadWrite)
+	int32 page = 1;
+};
+
+// Every page of text that can be written and where it is shelved. Addresses and texts are both numbered below
+// 29^pageLength and mapped to each other by a fixed permutation, so either can be found from the other
+class TOME_API FLibraryOfBabel
+{
+public:
+	// Layout of each hexagon, 1 based in addresses
+	static const int32 walls = 4;
+	static const int32 shelves = 5;
+	static const int32 volumes = 32;
+	static const int32 pages = 410;
+
+	// Same page size as books
+	static const int32 lineLength = 24;
+	static const int32 lineCount = 15;
+	static const int32 pageLength = lineLength * lineCount;
+
+	// Text of the page at an address, with a newline after every lineSize (0 for none).
+	// Returns false if the address is outside the library
+	static bool GetPage(const FBabelAddress &address, FString &outText, int32 lineSize = lineLength);
+
+	// Address of the page starting with text, the rest of the page is spaces. Case and newlines are ignored.
+	// Returns false if text is longer than a page or has characters outside the alphabet
+	static bool FindPage(const FString &text, FBabelAddress &outAddress);
+
+	// Number of an address, returns false if it's outside the library
+	static bool AddressToNumber(const FBabelAddress &address, FBabelNumber &outNumber);
+	static void NumberToAddress(FBabelNumber number, FBabelAddress &outAddress);
+
+	// Number of a page of text, the first symbol is the lowest base 29 digit
+	static bool TextToNumber(const FString &text, FBabelNumber &outNumber);
+	static void NumberToText(FBabelNumber number, int32 lineSize, FString &outText);
+
+	// Permutation of the numbers below 29^pageLength, from addresses to texts and back
+	static FBabelNumber Permute(const FBabelNumber &number);
+	static FBabelNumber Unpermute(const FBabelNumber &number);
+};
+
+// Library of Babel lookups for blueprints
+UCLASS()
+class TOME_API UBabelFunctionLibrary : public UBlueprintFunctionLibrary
+{
+	GENERATED_BODY()
+
+public:
+	// Text of the page at an address, returns false if the address is outside the library
+	UFUNCTION(BlueprintCallable, Category = "Library of Babel")
+	static bool GetBabelPage(const FBabelAddress &address, FString &text);
+
+	// Address of the page starting with text, returns false if no page can hold it
+	UFUNCTION(BlueprintCallable, Category = "Library of Babel")
+	static bool FindBabelPage(const FString &text, FBabelAddress &address);
+};
@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PageStore.h"
+#include "BookText.h"
+
+void FPackedPage::Generate(int32 newPage, uint64 key, int32 newLength)
+{
+	page = newPage;
+	length = FMath::Max(newLength, 0);
+	words.SetNumUninitialized(FBookText::PackedWords(length));
+	FBookText::GeneratePacked(key, length, true, words.GetData());
+}
+
+bool FPageStore::Contains(int32 page) const
+{
+	return Find(page) != nullptr;
+}
+
+void FPageStore::Add(int32 page, uint64 key, int32 length, int32 maxBytes)
+{
+	if (Contains(page))
+		return;
+
+	FPackedPage added;
+	added.Generate(page, key, length);
+	Add(MoveTemp(added), maxBytes);
+}
+
+void FPageStore::Add(FPackedPage &&added, int32 maxBytes)
+{
+	if (Contains(added.page))
+		return;
+
+	// Make room, always keeping the new page
+	int32 bytes = PageBytes(added);
+	if (maxBytes > 0)
+	{
+		int32 drop = 0;
+		while (drop < pages_.Num() && usedBytes_ + bytes > maxBytes)
+			usedBytes_ -= PageBytes(pages_[drop++]);
+		pages_.RemoveAt(0, drop, false);
+	}
+
+	usedBytes_ += bytes;
+	pages_.Add(MoveTemp(added));
+}
+
+bool FPageStore::Expand(int32 page, int32 lineSize, FString &outText) const
+{
+	const FPackedPage *found = Find(page);
+	if (found == nullptr)
+		return false;
+
+	int32 outputLength = FBookText::OutputLength(found->length, lineSize);
+	TArray<TCHAR> &chars = outText.GetCharArray();
+	if (outputLength == 0)
+	{
+		chars.Reset();
+		return true;
+	}
+
+	chars.SetNumUninitialized(outputLength + 1);
+	FBookText::Unpack(found->words.GetData(), found->length, lineSize, chars.GetData());
+	chars[outputLength] = 0;
+	return true;
+}
+
+void FPageStore::Empty()
+{
+	pages_.Empty();
+	usedBytes_ = 0;
+}
+
+const FPackedPage *FPageStore::Find(int32 page) const
+{
+	return pages_.FindByPredicate([page](const FPackedPage &stored) { return stored.page == page; });
+}
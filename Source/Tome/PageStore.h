@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+
+// A page's text packed at 5 bits per symbol (see FBookText)
+struct TOME_API FPackedPage
+{
+	int32 page = 0;
+	int32 length = 0;
+	TArray<uint64> words;
+
+	// Generate from a page key, safe on any thread
+	void Generate(int32 newPage, uint64 key, int32 newLength);
+};
+
+// Page to generate off the game thread
+struct FPagePrefetch
+{
+	int32 page;
+	uint64 key;
+	int32 length;
+};
+
+// Pages to generate off the game thread, shared between the game thread and the prefetch task
+struct FPagePrefetchBatch
+{
+	TArray<FPagePrefetch> pages; // Most needed first
+
+	TQueue<FPackedPage, EQueueMode::Spsc> results;
+	FThreadSafeBool cancelled;
+	FThreadSafeBool done;
+};
+
+// Generated pages of a book, packed at 5 bits per symbol (see FBookText). Newlines aren't stored, they go back in
+// when a page is expanded for display
+class TOME_API FPageStore
+{
+public:
+	// Whether a page is stored
+	bool Contains(int32 page) const;
+
+	// Generate and store a page. Oldest pages are dropped to stay under maxBytes (0 for no limit)
+	void Add(int32 page, uint64 key, int32 length, int32 maxBytes = 0);
+
+	// Store a page generated elsewhere, ignored if already stored
+	void Add(FPackedPage &&page, int32 maxBytes = 0);
+
+	// A stored page, null if not stored
+	const FPackedPage *Find(int32 page) const;
+
+	// Expand a stored page to text with a newline after every lineSize. Returns false if not stored
+	bool Expand(int32 page, int32 lineSize, FString &outText) const;
+
+	// Drop every page
+	void Empty();
+
+	int32 Num() const { return pages_.Num(); }
+
+	// Memory used by stored pages
+	int32 GetUsedBytes() const { return usedBytes_; }
+
+private:
+	static int32 PageBytes(const FPackedPage &page) { return sizeof(FPackedPage) + page.words.GetAllocatedSize(); }
+
+	// Oldest first, books only keep a handful of pages open
+	TArray<FPackedPage> pages_;
+	int32 usedBytes_ = 0;
+};
@@ -0,0 +1,163 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TileCache.h"
+#include "TileRules.h"
+
+void FTileCache::SetCapacityBytes(int32 bytes)
+{
+	capacityBlocks_ = FMath::Max(bytes, 0) / int32(sizeof(Block));
+
+	while (blocks_.Num() > capacityBlocks_)
+		EvictLeastRecent();
+}
+
+int32 FTileCache::GetBytesFor(FIntVector size)
+{
+	// Blocks spanned per axis when the box doesn't line up with them
+	FIntVector blocks;
+	for (int32 i = 0; i < 3; i++)
+		blocks[i] = (FMath::Max(size[i], 1) + blockMask) / blockSize + 1;
+
+	return blocks.X * blocks.Y * blocks.Z * int32(sizeof(Block));
+}
+
+void FTileCache::Store(FIntVector coord, int32 variant)
+{
+	if (capacityBlocks_ == 0 || variant == FTileRules::VARIANT_UNLOADED)
+		return;
+
+	FIntVector blockCoord = BlockCoord(coord);
+	int32 *found = blockIndices_.Find(blockCoord);
+	int32 block;
+
+	if (found != nullptr)
+		block = *found;
+	else
+	{
+		if (blocks_.Num() >= capacityBlocks_)
+			EvictLeastRecent();
+
+		// New block with nothing cached
+		block = blocks_.AddUninitialized();
+		blocks_[block].coord = blockCoord;
+		blocks_[block].lessRecent = INDEX_NONE;
+		blocks_[block].moreRecent = INDEX_NONE;
+		FMemory::Memzero(blocks_[block].cells);
+		blockIndices_.Add(blockCoord, block);
+	}
+
+	blocks_[block].cells[CellIndex(coord)] = uint16(variant + 2);
+	Touch(block);
+}
+
+int32 FTileCache::Find(FIntVector coord)
+{
+	int32 *block = blockIndices_.Find(BlockCoord(coord));
+	uint16 cell = block != nullptr ? blocks_[*block].cells[CellIndex(coord)] : 0;
+
+	if (cell == 0)
+	{
+		misses++;
+		return FTileRules::VARIANT_UNLOADED;
+	}
+
+	hits++;
+	Touch(*block);
+	return int32(cell) - 2;
+}
+
+bool FTileCache::Contains(FIntVector coord) const
+{
+	const int32 *block = blockIndices_.Find(BlockCoord(coord));
+	return block != nullptr && blocks_[*block].cells[CellIndex(coord)] != 0;
+}
+
+int32 FTileCache::Peek(FIntVector coord) const
+{
+	const int32 *block = blockIndices_.Find(BlockCoord(coord));
+	uint16 cell = block != nullptr ? blocks_[*block].cells[CellIndex(coord)] : 0;
+	return int32(cell) - 2;
+}
+
+void FTileCache::Empty()
+{
+	blocks_.Empty();
+	blockIndices_.Empty();
+	leastRecent_ = INDEX_NONE;
+	mostRecent_ = INDEX_NONE;
+}
+
+FIntVector FTileCache::BlockCoord(FIntVector coord)
+{
+	// Arithmetic shift rounds negatives down, so blocks don't straddle zero
+	return FIntVector(coord.X >> blockShift, coord.Y >> blockShift, coord.Z >> blockShift);
+}
+
+int32 FTileCache::CellIndex(FIntVector coord)
+{
+	return (coord.X & blockMask) | (coord.Y & blockMask) << blockShift | (coord.Z & blockMask) << (blockShift * 2);
+}
+
+void FTileCache::Touch(int32 block)
+{
+	if (mostRecent_ == block)
+		return;
+
+	Unlink(block);
+
+	// Add to most recent end
+	blocks_[block].lessRecent = mostRecent_;
+	if (mostRecent_ != INDEX_NONE)
+		blocks_[mostRecent_].moreRecent = block;
+	mostRecent_ = block;
+	if (leastRecent_ == INDEX_NONE)
+		leastRecent_ = block;
+}
+
+void FTileCache::Unlink(int32 block)
+{
+	Block &current = blocks_[block];
+
+	if (current.lessRecent != INDEX_NONE)
+		blocks_[current.lessRecent].moreRecent = current.moreRecent;
+	else if (leastRecent_ == block)
+		leastRecent_ = current.moreRecent;
+
+	if (current.moreRecent != INDEX_NONE)
+		blocks_[current.moreRecent].lessRecent = current.lessRecent;
+	else if (mostRecent_ == block)
+		mostRecent_ = current.lessRecent;
+
+	current.lessRecent = INDEX_NONE;
+	current.moreRecent = INDEX_NONE;
+}
+
+void FTileCache::EvictLeastRecent()
+{
+	int32 block = leastRecent_;
+	if (block == INDEX_NONE)
+		return;
+
+	Unlink(block);
+	blockIndices_.Remove(blocks_[block].coord);
+	evictions++;
+
+	// Fill the hole with the last block
+	int32 last = blocks_.Num() - 1;
+	if (block != last)
+	{
+		Block &moved = blocks_[last];
+		if (moved.lessRecent != INDEX_NONE)
+			blocks_[moved.lessRecent].moreRecent = block;
+		else
+			leastRecent_ = block;
+		if (moved.moreRecent != INDEX_NONE)
+			blocks_[moved.moreRecent].lessRecent = block;
+		else
+			mostRecent_ = block;
+
+		blockIndices_[moved.coord] = block;
+	}
+	blocks_.RemoveAtSwap(block, 1, false);
+}
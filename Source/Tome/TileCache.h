@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Variants of unloaded cells, stored in blocks of 8x8x8 cells at 2 bytes each and evicted least recently used first
+class TOME_API FTileCache
+{
+public:
+	// Memory the cache may use, evicting blocks to fit
+	void SetCapacityBytes(int32 bytes);
+
+	// Remember a cell's variant (or VARIANT_EMPTY)
+	void Store(FIntVector coord, int32 variant);
+
+	// Get a cell's variant (or VARIANT_EMPTY), VARIANT_UNLOADED if not cached
+	int32 Find(FIntVector coord);
+
+	// Whether a cell is cached, without touching its block
+	bool Contains(FIntVector coord) const;
+
+	// Get a cell's variant like Find, without touching its block or counting a hit
+	int32 Peek(FIntVector coord) const;
+
+	// Forget everything (variant indices changed)
+	void Empty();
+
+	// Memory used by blocks
+	int32 GetUsedBytes() const { return blocks_.Num() * sizeof(Block); }
+
+	// Memory needed to hold every cell of a box of a size, wherever it lies
+	static int32 GetBytesFor(FIntVector size);
+
+	int32 hits = 0;
+	int32 misses = 0;
+	int32 evictions = 0;
+
+private:
+	static const int32 blockShift = 3;
+	static const int32 blockSize = 1 << blockShift;
+	static const int32 blockMask = blockSize - 1;
+
+	struct Block
+	{
+		FIntVector coord;
+
+		// Neighbors in recently used list
+		int32 lessRecent = INDEX_NONE;
+		int32 moreRecent = INDEX_NONE;
+
+		// 0 if not cached, otherwise variant + 2 (so empty is 1)
+		uint16 cells[blockSize * blockSize * blockSize];
+	};
+
+	static FIntVector BlockCoord(FIntVector coord);
+	static int32 CellIndex(FIntVector coord);
+
+	// Move block to most recent end of list
+	void Touch(int32 block);
+
+	// Remove block from recently used list
+	void Unlink(int32 block);
+
+	// Remove least recently used block
+	void EvictLeastRecent();
+
+	TArray<Block> blocks_;
+	TMap<FIntVector, int32> blockIndices_;
+	int32 leastRecent_ = INDEX_NONE;
+	int32 mostRecent_ = INDEX_NONE;
+	int32 capacityBlocks_ = 0;
+};
@@ -0,0 +1,285 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TileChunkSolver.h"
+
+// Corresponds to ETileDirection
+static const FIntVector chunkDirections[] = {
+	FIntVector(-1, 0, 0),
+	FIntVector(1, 0, 0),
+	FIntVector(0, -1, 0),
+	FIntVector(0, 1, 0),
+	FIntVector(0, 0, -1),
+	FIntVector(0, 0, 1)
+};
+
+FTileChunkSolver::FTileChunkSolver(const FTileRules &rules) : rules_(rules)
+{
+}
+
+void FTileChunkSolver::Solve(FIntVector origin, FIntVector size, TFunctionRef<int32(FIntVector)> known, int32 seed, bool hashed, int32 backtrackBudget, TArray<int32> &outVariants)
+{
+	origin_ = origin;
+	size_ = size;
+	words_ = rules_.NumWords();
+	backtracks = 0;
+	holes = 0;
+	conflicts = 0;
+
+	int32 cellCount = size.X * size.Y * size.Z;
+	domains_.SetNumZeroed(cellCount * words_);
+	empty_.Init(false, cellCount);
+	fixed_.Init(false, cellCount);
+	queued_.Init(false, cellCount);
+	queue_.Reset();
+
+	// Start from what fits the loaded cells around each cell
+	for (int32 cell = 0; cell < cellCount; cell++)
+	{
+		FIntVector coord = origin + CellCoord(cell);
+		int32 fixed = known(coord);
+
+		if (fixed == FTileRules::VARIANT_EMPTY || rules_.NumVariants() == 0)
+		{
+			empty_[cell] = true;
+			fixed_[cell] = fixed == FTileRules::VARIANT_EMPTY;
+			Enqueue(cell);
+			continue;
+		}
+
+		if (fixed >= 0)
+		{
+			Domain(cell)[fixed / 64] = uint64(1) << (fixed % 64);
+			fixed_[cell] = true;
+			Enqueue(cell);
+
+			// Loaded next to something it doesn't fit, nothing to solve but worth knowing
+			for (uint8 d = 0; d < uint8(ETileDirection::TD_MAX); d++)
+			{
+				int32 adjacent = known(coord + chunkDirections[d]);
+				if (adjacent == FTileRules::VARIANT_UNLOADED)
+					continue;
+
+				const uint64 *allowed = rules_.GetAdjacent(adjacent, FTileRules::ReverseDirection(ETileDirection(d)));
+				if (((allowed[fixed / 64] >> (fixed % 64)) & 1) == 0)
+				{
+					conflicts++;
+					break;
+				}
+			}
+			continue;
+		}
+
+		// Cells inside the block constrain through propagation
+		int32 neighbors[uint8(ETileDirection::TD_MAX)];
+		for (uint8 d = 0; d < uint8(ETileDirection::TD_MAX); d++)
+		{
+			FIntVector adjacent = coord + chunkDirections[d];
+			neighbors[d] = CellIndex(adjacent - origin) != INDEX_NONE ? FTileRules::VARIANT_UNLOADED : known(adjacent);
+		}
+
+		FTileVariantMask candidates;
+		rules_.GetCandidates(neighbors, coord == FIntVector(0, 0, 0), candidates);
+		FMemory::Memcpy(Domain(cell), candidates.words.GetData(), words_ * sizeof(uint64));
+		Enqueue(cell);
+	}
+
+	FRandomStream random(seed);
+	TArray<Snapshot> decisions;
+	bool consistent = Propagate();
+
+	while (true)
+	{
+		if (!consistent)
+		{
+			// Undo the last decision and rule out what it picked
+			if (decisions.Num() > 0 && backtracks < backtrackBudget)
+			{
+				Snapshot snapshot = decisions.Pop(false);
+				domains_ = MoveTemp(snapshot.domains);
+				empty_ = MoveTemp(snapshot.empty);
+				backtracks++;
+
+				queue_.Reset();
+				queued_.Init(false, cellCount);
+
+				Domain(snapshot.cell)[snapshot.variant / 64] &= ~(uint64(1) << (snapshot.variant % 64));
+				Enqueue(snapshot.cell);
+				consistent = Propagate();
+				continue;
+			}
+
+			// Out of budget, nothing fits in cells with empty domains so leave holes and keep going. Loaded cells
+			// are never narrowed so these are always cells being solved
+			decisions.Reset();
+			for (int32 cell = 0; cell < cellCount; cell++)
+			{
+				if (!empty_[cell] && !fixed_[cell] && Count(cell) == 0)
+				{
+					empty_[cell] = true;
+					holes++;
+					Enqueue(cell);
+				}
+			}
+			consistent = Propagate();
+			continue;
+		}
+
+		// Find the undecided cell with the fewest options
+		int32 best = INDEX_NONE;
+		int32 bestCount = MAX_int32;
+		for (int32 cell = 0; cell < cellCount; cell++)
+		{
+			if (empty_[cell])
+				continue;
+
+			int32 count = Count(cell);
+			if (count > 1 && count < bestCount)
+			{
+				best = cell;
+				bestCount = count;
+			}
+		}
+
+		// Everything decided
+		if (best == INDEX_NONE)
+			break;
+
+		// Pick one of its options
+		uint32 roll = hashed ? FTileRules::HashCoord(seed, origin + CellCoord(best)) : random.GetUnsignedInt();
+		int32 n = int32((uint64(roll) * uint64(bestCount)) >> 32);
+		int32 chosen = INDEX_NONE;
+		for (int32 w = 0; w < words_ && chosen == INDEX_NONE; w++)
+		{
+			uint64 word = Domain(best)[w];
+			int32 bits = FPlatformMath::CountBits(word);
+			if (n >= bits)
+			{
+				n -= bits;
+				continue;
+			}
+			for (; n > 0; n--)
+				word &= word - 1;
+			chosen = w * 64 + int32(FPlatformMath::CountTrailingZeros64(word));
+		}
+
+		// Remember state to come back to, only while backtracking is still allowed
+		if (backtracks < backtrackBudget)
+			decisions.Add({ domains_, empty_, best, chosen });
+
+		FMemory::Memzero(Domain(best), words_ * sizeof(uint64));
+		Domain(best)[chosen / 64] = uint64(1) << (chosen % 64);
+		Enqueue(best);
+		consistent = Propagate();
+	}
+
+	// Read out decided cells
+	outVariants.SetNumUninitialized(cellCount);
+	for (int32 cell = 0; cell < cellCount; cell++)
+	{
+		outVariants[cell] = FTileRules::VARIANT_EMPTY;
+		if (empty_[cell])
+			continue;
+
+		for (int32 w = 0; w < words_; w++)
+		{
+			if (Domain(cell)[w] != 0)
+			{
+				outVariants[cell] = w * 64 + int32(FPlatformMath::CountTrailingZeros64(Domain(cell)[w]));
+				break;
+			}
+		}
+	}
+}
+
+int32 FTileChunkSolver::Count(int32 cell)
+{
+	int32 count = 0;
+	for (int32 w = 0; w < words_; w++)
+		count += FPlatformMath::CountBits(Domain(cell)[w]);
+	return count;
+}
+
+FIntVector FTileChunkSolver::CellCoord(int32 cell) const
+{
+	return FIntVector(cell % size_.X, (cell / size_.X) % size_.Y, cell / (size_.X * size_.Y));
+}
+
+int32 FTileChunkSolver::CellIndex(FIntVector local) const
+{
+	if (local.X < 0 || local.Y < 0 || local.Z < 0 || local.X >= size_.X || local.Y >= size_.Y || local.Z >= size_.Z)
+		return INDEX_NONE;
+
+	return local.X + (local.Y + local.Z * size_.Y) * size_.X;
+}
+
+void FTileChunkSolver::Enqueue(int32 cell)
+{
+	if (queued_[cell])
+		return;
+
+	queued_[cell] = true;
+	queue_.Add(cell);
+}
+
+bool FTileChunkSolver::Propagate()
+{
+	TArray<uint64, TInlineAllocator<4>> allowed;
+	allowed.SetNumUninitialized(words_);
+
+	while (queue_.Num() > 0)
+	{
+		int32 cell = queue_.Last();
+
+		// Nothing fits here, caller decides what to do
+		if (!empty_[cell] && Count(cell) == 0)
+			return false;
+
+		queue_.Pop(false);
+		queued_[cell] = false;
+
+		FIntVector local = CellCoord(cell);
+		for (uint8 d = 0; d < uint8(ETileDirection::TD_MAX); d++)
+		{
+			int32 adjacent = CellIndex(local + chunkDirections[d]);
+			// Loaded cells constrain others but stay as loaded, any conflict is left to the cells around them
+			if (adjacent == INDEX_NONE || empty_[adjacent] || fixed_[adjacent])
+				continue;
+
+			// Union of what every option here allows in that direction
+			FMemory::Memzero(allowed.GetData(), words_ * sizeof(uint64));
+			if (empty_[cell])
+			{
+				const uint64 *mask = rules_.GetAdjacent(FTileRules::VARIANT_EMPTY, ETileDirection(d));
+				for (int32 w = 0; w < words_; w++)
+					allowed[w] = mask[w];
+			}
+			else
+			{
+				for (int32 w = 0; w < words_; w++)
+				{
+					for (uint64 word = Domain(cell)[w]; word != 0; word &= word - 1)
+					{
+						int32 variant = w * 64 + int32(FPlatformMath::CountTrailingZeros64(word));
+						const uint64 *mask = rules_.GetAdjacent(variant, ETileDirection(d));
+						for (int32 x = 0; x < words_; x++)
+							allowed[x] |= mask[x];
+					}
+				}
+			}
+
+			// Narrow neighbor, and requeue it if it changed
+			bool changed = false;
+			uint64 *domain = Domain(adjacent);
+			for (int32 w = 0; w < words_; w++)
+			{
+				uint64 narrowed = domain[w] & allowed[w];
+				changed |= narrowed != domain[w];
+				domain[w] = narrowed;
+			}
+			if (changed)
+				Enqueue(adjacent);
+		}
+	}
+	return true;
+}
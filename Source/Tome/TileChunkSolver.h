@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TileRules.h"
+
+// Solves a block of cells at once: propagates constraints between cells, collapses the lowest entropy cell first
+// and backtracks on contradictions until out of budget, then leaves holes where nothing fits. Loaded cells are never
+// changed or left as holes, only the cells solved around them
+class TOME_API FTileChunkSolver
+{
+public:
+	FTileChunkSolver(const FTileRules &rules);
+
+	// Solve cells in [origin, origin + size). known returns variants (or VARIANT_EMPTY) of loaded cells inside and
+	// around the block, VARIANT_UNLOADED for cells to solve or ignore. Rolls come from seed hashed with the coordinate
+	// if hashed, otherwise from a stream. outVariants is indexed x, then y, then z
+	void Solve(FIntVector origin, FIntVector size, TFunctionRef<int32(FIntVector)> known, int32 seed, bool hashed, int32 backtrackBudget, TArray<int32> &outVariants);
+
+	// Stats from last solve
+	int32 backtracks = 0;
+	int32 holes = 0;
+	int32 conflicts = 0; // Loaded cells that don't fit next to other loaded cells, kept as they are
+
+private:
+	struct Snapshot
+	{
+		TArray<uint64> domains;
+		TArray<bool> empty;
+		int32 cell;
+		int32 variant;
+	};
+
+	uint64 *Domain(int32 cell) { return &domains_[cell * words_]; }
+	int32 Count(int32 cell);
+	FIntVector CellCoord(int32 cell) const;
+	int32 CellIndex(FIntVector local) const;
+
+	// Queue a cell to have its domain pushed onto its neighbors
+	void Enqueue(int32 cell);
+
+	// Narrow neighbors of queued cells until nothing changes. Returns false on an empty domain (queue is kept)
+	bool Propagate();
+
+	const FTileRules &rules_;
+	int32 words_ = 0;
+	FIntVector origin_;
+	FIntVector size_;
+
+	// Possible variants per cell, words_ each
+	TArray<uint64> domains_;
+
+	// Cells decided as empty space
+	TArray<bool> empty_;
+
+	// Loaded cells, never narrowed
+	TArray<bool> fixed_;
+
+	TArray<int32> queue_;
+	TArray<bool> queued_;
+};
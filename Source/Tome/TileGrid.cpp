@@ -0,0 +1,164 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TileGrid.h"
+#include "TileRules.h"
+
+void FTileGrid::Add(FIntVector coord, int32 variant, uint32 flags)
+{
+	FIntVector chunkCoord = ChunkCoord(coord);
+	int32 *found = chunkIndices_.Find(chunkCoord);
+	int32 chunk;
+
+	if (found != nullptr)
+		chunk = *found;
+	else
+	{
+		// New chunk with nothing loaded
+		TUniquePtr<Chunk> added = freeChunks_.Num() > 0 ? freeChunks_.Pop(false) : MakeUnique<Chunk>();
+		added->coord = chunkCoord;
+		added->loaded = 0;
+		FMemory::Memzero(added->cells);
+
+		chunk = chunks_.Add(MoveTemp(added));
+		chunkIndices_.Add(chunkCoord, chunk);
+	}
+
+	uint32 &cell = chunks_[chunk]->cells[CellIndex(coord)];
+	if (cell == 0)
+	{
+		chunks_[chunk]->loaded++;
+		num_++;
+	}
+	cell = uint32(variant + 2) | flags;
+}
+
+bool FTileGrid::Remove(FIntVector coord, int32 &outVariant, uint32 &outFlags)
+{
+	FIntVector chunkCoord = ChunkCoord(coord);
+	int32 *found = chunkIndices_.Find(chunkCoord);
+	if (found == nullptr)
+		return false;
+
+	int32 chunk = *found;
+	uint32 &cell = chunks_[chunk]->cells[CellIndex(coord)];
+	if (cell == 0)
+		return false;
+
+	outVariant = int32(cell & variantMask) - 2;
+	outFlags = cell & ~variantMask;
+	cell = 0;
+	num_--;
+
+	if (--chunks_[chunk]->loaded > 0)
+		return true;
+
+	// Free empty chunk, filling the hole with the last one
+	chunkIndices_.Remove(chunkCoord);
+	if (freeChunks_.Num() < maxFreeChunks)
+		freeChunks_.Add(MoveTemp(chunks_[chunk]));
+	chunks_.RemoveAtSwap(chunk, 1, false);
+	if (chunk < chunks_.Num())
+		chunkIndices_[chunks_[chunk]->coord] = chunk;
+	lastChunk_ = INDEX_NONE;
+	return true;
+}
+
+int32 FTileGrid::Find(FIntVector coord) const
+{
+	const Chunk *chunk = FindChunk(coord);
+	uint32 cell = chunk != nullptr ? chunk->cells[CellIndex(coord)] : 0;
+	return int32(cell & variantMask) - 2;
+}
+
+uint32 FTileGrid::FindFlags(FIntVector coord) const
+{
+	const Chunk *chunk = FindChunk(coord);
+	return chunk != nullptr ? chunk->cells[CellIndex(coord)] & ~variantMask : 0;
+}
+
+bool FTileGrid::Contains(FIntVector coord) const
+{
+	return Find(coord) != FTileRules::VARIANT_UNLOADED;
+}
+
+void FTileGrid::GetNeighbors(FIntVector coord, int32 outNeighbors[6]) const
+{
+	FIntVector local(coord.X & chunkMask, coord.Y & chunkMask, coord.Z & chunkMask);
+
+	// Cells on the chunk border have neighbors in other chunks
+	if (local.X == 0 || local.Y == 0 || local.Z == 0 || local.X == chunkMask || local.Y == chunkMask || local.Z == chunkMask)
+	{
+		outNeighbors[0] = Find(coord + FIntVector(-1, 0, 0));
+		outNeighbors[1] = Find(coord + FIntVector(1, 0, 0));
+		outNeighbors[2] = Find(coord + FIntVector(0, -1, 0));
+		outNeighbors[3] = Find(coord + FIntVector(0, 1, 0));
+		outNeighbors[4] = Find(coord + FIntVector(0, 0, -1));
+		outNeighbors[5] = Find(coord + FIntVector(0, 0, 1));
+		return;
+	}
+
+	const Chunk *chunk = FindChunk(coord);
+	if (chunk == nullptr)
+	{
+		for (int32 d = 0; d < 6; d++)
+			outNeighbors[d] = FTileRules::VARIANT_UNLOADED;
+		return;
+	}
+
+	// Corresponds to ETileDirection
+	static const int32 strides[] = { -1, 1, -chunkSize, chunkSize, -chunkSize * chunkSize, chunkSize * chunkSize };
+
+	const uint32 *cell = &chunk->cells[CellIndex(coord)];
+	for (int32 d = 0; d < 6; d++)
+		outNeighbors[d] = int32(cell[strides[d]] & variantMask) - 2;
+}
+
+void FTileGrid::GetCoords(TArray<FIntVector> &outCoords) const
+{
+	outCoords.Reset(num_);
+
+	for (const TUniquePtr<Chunk> &chunk : chunks_)
+	{
+		FIntVector origin = chunk->coord * chunkSize;
+		for (int32 i = 0; i < chunkSize * chunkSize * chunkSize; i++)
+		{
+			if (chunk->cells[i] != 0)
+				outCoords.Add(origin + FIntVector(i & chunkMask, (i >> chunkShift) & chunkMask, i >> (chunkShift * 2)));
+		}
+	}
+}
+
+void FTileGrid::Empty()
+{
+	chunks_.Empty();
+	chunkIndices_.Empty();
+	freeChunks_.Empty();
+	lastChunk_ = INDEX_NONE;
+	num_ = 0;
+}
+
+FIntVector FTileGrid::ChunkCoord(FIntVector coord)
+{
+	// Arithmetic shift rounds negatives down, so chunks don't straddle zero
+	return FIntVector(coord.X >> chunkShift, coord.Y >> chunkShift, coord.Z >> chunkShift);
+}
+
+int32 FTileGrid::CellIndex(FIntVector coord)
+{
+	return (coord.X & chunkMask) | (coord.Y & chunkMask) << chunkShift | (coord.Z & chunkMask) << (chunkShift * 2);
+}
+
+const FTileGrid::Chunk *FTileGrid::FindChunk(FIntVector coord) const
+{
+	FIntVector chunkCoord = ChunkCoord(coord);
+	if (lastChunk_ != INDEX_NONE && chunks_[lastChunk_]->coord == chunkCoord)
+		return chunks_[lastChunk_].Get();
+
+	const int32 *found = chunkIndices_.Find(chunkCoord);
+	if (found == nullptr)
+		return nullptr;
+
+	lastChunk_ = *found;
+	return chunks_[lastChunk_].Get();
+}
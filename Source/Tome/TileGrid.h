@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Loaded cells, stored densely in chunks of 16x16x16 cells at 4 bytes each. Chunks are allocated when their first
+// cell loads and freed when their last cell unloads
+class TOME_API FTileGrid
+{
+public:
+	// Extra state stored with a cell
+	enum ECellFlags : uint32
+	{
+		CELL_ACTOR = 1 << 16,     // Has a tile actor
+		CELL_INSTANCED = 1 << 17, // Drawn with instances
+		CELL_PROXY = 1 << 18,     // In the proxy tier, drawn as its variant's proxy mesh
+		CELL_FAR = 1 << 19,       // In the far tier, drawn by its far chunk
+	};
+
+	// Load a cell with a variant (or VARIANT_EMPTY) and flags
+	void Add(FIntVector coord, int32 variant, uint32 flags = 0);
+
+	// Unload a cell. Returns false if it wasn't loaded
+	bool Remove(FIntVector coord, int32 &outVariant, uint32 &outFlags);
+
+	// Get a cell's variant (or VARIANT_EMPTY), VARIANT_UNLOADED if not loaded
+	int32 Find(FIntVector coord) const;
+
+	// Get a cell's flags, 0 if not loaded
+	uint32 FindFlags(FIntVector coord) const;
+
+	// Whether a cell is loaded
+	bool Contains(FIntVector coord) const;
+
+	// Get variants of the cells around a cell (indexed by ETileDirection)
+	void GetNeighbors(FIntVector coord, int32 outNeighbors[6]) const;
+
+	// Get coordinates of every loaded cell
+	void GetCoords(TArray<FIntVector> &outCoords) const;
+
+	// Unload everything
+	void Empty();
+
+	int32 Num() const { return num_; }
+
+	// Memory used by chunks
+	int32 GetUsedBytes() const { return chunks_.Num() * sizeof(Chunk); }
+
+private:
+	static const int32 chunkShift = 4;
+	static const int32 chunkSize = 1 << chunkShift;
+	static const int32 chunkMask = chunkSize - 1;
+
+	// Low 16 bits are 0 if not loaded, otherwise variant + 2 (so empty is 1). High bits are ECellFlags
+	static const uint32 variantMask = 0xFFFF;
+
+	struct Chunk
+	{
+		FIntVector coord;
+		int32 loaded = 0;
+		uint32 cells[chunkSize * chunkSize * chunkSize];
+	};
+
+	static FIntVector ChunkCoord(FIntVector coord);
+	static int32 CellIndex(FIntVector coord);
+
+	// Chunk containing a cell, or null if none is loaded there
+	const Chunk *FindChunk(FIntVector coord) const;
+
+	TArray<TUniquePtr<Chunk>> chunks_;
+	TMap<FIntVector, int32> chunkIndices_;
+
+	// Chunks freed for reuse, so moving around doesn't reallocate
+	TArray<TUniquePtr<Chunk>> freeChunks_;
+	static const int32 maxFreeChunks = 8;
+
+	// Last chunk looked up, neighbor lookups usually hit the same one
+	mutable int32 lastChunk_ = INDEX_NONE;
+
+	int32 num_ = 0;
+};
@@ -0,0 +1,346 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TileRules.h"
+
+void FTileVariantMask::Init(int32 count, bool value)
+{
+	words.Reset();
+	words.AddZeroed((count + 63) / 64);
+
+	if (!value)
+		return;
+
+	for (int32 i = 0; i < words.Num(); i++)
+		words[i] = ~uint64(0);
+
+	// Clear bits past the end
+	if (count % 64 != 0)
+		words.Last() = (uint64(1) << (count % 64)) - 1;
+}
+
+void FTileVariantMask::And(const FTileVariantMask &other)
+{
+	for (int32 i = 0; i < words.Num(); i++)
+		words[i] &= other.words[i];
+}
+
+void FTileVariantMask::AndNot(const FTileVariantMask &other)
+{
+	for (int32 i = 0; i < words.Num(); i++)
+		words[i] &= ~other.words[i];
+}
+
+int32 FTileVariantMask::CountSet() const
+{
+	int32 count = 0;
+	for (uint64 word : words)
+		count += FPlatformMath::CountBits(word);
+	return count;
+}
+
+int32 FTileVariantMask::FindNthSet(int32 n) const
+{
+	for (int32 i = 0; i < words.Num(); i++)
+	{
+		uint64 word = words[i];
+		int32 count = FPlatformMath::CountBits(word);
+
+		// Skip whole words
+		if (n >= count)
+		{
+			n -= count;
+			continue;
+		}
+
+		// Clear lowest bits until at the nth
+		for (; n > 0; n--)
+			word &= word - 1;
+
+		return i * 64 + int32(FPlatformMath::CountTrailingZeros64(word));
+	}
+	return INDEX_NONE;
+}
+
+void FTileRules::Compile(const UDataTable *table)
+{
+	source_ = table;
+	variants_.Reset();
+	blacklistedBy_.Reset();
+
+	TArray<const FTileInfo *> tiles;
+
+	if (table != nullptr)
+	{
+		for (const TPair<FName, uint8*> &row : table->GetRowMap())
+		{
+			const FTileInfo *info = reinterpret_cast<FTileInfo *>(row.Value);
+			int32 tile = tiles.Add(info);
+
+			// Same order GenerateTile has always tried tiles in: rotations, then mirrors
+			for (uint8 r = 0; r < uint8(ETileRotation::ROT_MAX); r++)
+			{
+				for (uint8 s = 0; s < (info->mirror ? 2 : 1); s++)
+				{
+					FTileVariant &variant = variants_.AddDefaulted_GetRef();
+					variant.info = info;
+					variant.tile = tile;
+					variant.rotation = ETileRotation(r);
+					variant.mirrored = s != 0;
+
+					for (uint8 d = 0; d < uint8(ETileDirection::TD_MAX); d++)
+						variant.connections[d] = GetConnection(info, ETileDirection(d), variant.rotation, variant.GetScale());
+				}
+			}
+		}
+	}
+
+	int32 count = variants_.Num();
+
+	// Allocate masks
+	for (uint8 d = 0; d < uint8(ETileDirection::TD_MAX); d++)
+	{
+		for (uint8 c = 0; c < uint8(ETileConnection::TC_MAX); c++)
+			compatible_[d][c].Init(count, false);
+	}
+	for (FTileVariantMask &mask : orientation_)
+		mask.Init(count, false);
+	spawnable_.Init(count, false);
+	all_.Init(count, true);
+	blacklistedBy_.SetNum(tiles.Num());
+	for (FTileVariantMask &mask : blacklistedBy_)
+		mask.Init(count, false);
+
+	// Fill masks
+	for (int32 v = 0; v < count; v++)
+	{
+		const FTileVariant &variant = variants_[v];
+
+		for (uint8 d = 0; d < uint8(ETileDirection::TD_MAX); d++)
+			compatible_[d][uint8(variant.connections[d])].Set(v);
+
+		orientation_[OrientationIndex(variant.rotation, variant.mirrored)].Set(v);
+
+		if (variant.info->canSpawnOn)
+			spawnable_.Set(v);
+
+		for (int32 t = 0; t < tiles.Num(); t++)
+		{
+			if (variant.info->blacklisted.Contains(tiles[t]->object))
+				blacklistedBy_[t].Set(v);
+		}
+	}
+
+	// Adjacency in both directions for constraint propagation
+	int32 words = NumWords();
+	adjacent_.SetNumZeroed((count + 1) * uint8(ETileDirection::TD_MAX) * words);
+	for (int32 v = -1; v < count; v++)
+	{
+		int32 row = v >= 0 ? v : count;
+
+		for (uint8 d = 0; d < uint8(ETileDirection::TD_MAX); d++)
+		{
+			// Candidates for the cell in direction d, with this variant behind it
+			int32 neighbors[uint8(ETileDirection::TD_MAX)];
+			for (int32 &neighbor : neighbors)
+				neighbor = VARIANT_UNLOADED;
+			neighbors[uint8(ReverseDirection(ETileDirection(d)))] = v;
+
+			FTileVariantMask mask;
+			GetCandidates(neighbors, false, mask);
+
+			// Also drop what this variant blacklists
+			if (v >= 0)
+			{
+				for (int32 w = 0; w < count; w++)
+				{
+					if (variants_[v].info->blacklisted.Contains(variants_[w].info->object))
+						mask.words[w / 64] &= ~(uint64(1) << (w % 64));
+				}
+			}
+
+			FMemory::Memcpy(&adjacent_[(row * uint8(ETileDirection::TD_MAX) + d) * words], mask.words.GetData(), words * sizeof(uint64));
+		}
+	}
+}
+
+const uint64 *FTileRules::GetAdjacent(int32 variant, ETileDirection direction) const
+{
+	int32 row = variant >= 0 ? variant : variants_.Num();
+	return &adjacent_[(row * uint8(ETileDirection::TD_MAX) + uint8(direction)) * NumWords()];
+}
+
+void FTileRules::GetCandidates(const int32 neighbors[uint8(ETileDirection::TD_MAX)], bool spawn, FTileVariantMask &outCandidates) const
+{
+	outCandidates = spawn ? spawnable_ : all_;
+
+	for (uint8 d = 0; d < uint8(ETileDirection::TD_MAX); d++)
+	{
+		// If this tile hasn't loaded yet, ignore
+		if (neighbors[d] == VARIANT_UNLOADED)
+			continue;
+
+		// Empty space only fits empty connections
+		if (neighbors[d] == VARIANT_EMPTY)
+		{
+			outCandidates.And(compatible_[d][uint8(ETileConnection::TC_EMPTY)]);
+			continue;
+		}
+
+		// Connection must match the adjacent tile's connection facing this tile
+		const FTileVariant &adjacent = variants_[neighbors[d]];
+		ETileConnection adjacentConnection = adjacent.connections[uint8(ReverseDirection(ETileDirection(d)))];
+		outCandidates.And(compatible_[d][uint8(adjacentConnection)]);
+
+		// If stacked vertically, rotations must match too
+		bool vertical = d == uint8(ETileDirection::TD_ABOVE) || d == uint8(ETileDirection::TD_BELOW);
+		if (vertical && adjacentConnection != ETileConnection::TC_EMPTY)
+			outCandidates.And(orientation_[OrientationIndex(adjacent.rotation, adjacent.mirrored)]);
+
+		outCandidates.AndNot(blacklistedBy_[adjacent.tile]);
+	}
+}
+
+bool FTileRules::Fits(int32 variant, const int32 neighbors[uint8(ETileDirection::TD_MAX)], bool spawn) const
+{
+	if (variant >= variants_.Num())
+		return false;
+
+	if (variant != VARIANT_EMPTY)
+	{
+		FTileVariantMask candidates;
+		GetCandidates(neighbors, spawn, candidates);
+		return candidates.Get(variant);
+	}
+
+	// Empty space fits if no neighbor connects into it
+	for (uint8 d = 0; d < uint8(ETileDirection::TD_MAX); d++)
+	{
+		if (neighbors[d] >= 0 && variants_[neighbors[d]].connections[uint8(ReverseDirection(ETileDirection(d)))] != ETileConnection::TC_EMPTY)
+			return false;
+	}
+	return true;
+}
+
+int32 FTileRules::Solve(const int32 neighbors[uint8(ETileDirection::TD_MAX)], bool spawn, uint32 roll, int32 *outCandidateCount) const
+{
+	FTileVariantMask candidates;
+	GetCandidates(neighbors, spawn, candidates);
+
+	int32 count = candidates.CountSet();
+	if (outCandidateCount != nullptr)
+		*outCandidateCount = count;
+
+	if (count == 0)
+		return VARIANT_EMPTY;
+
+	// Scale roll to candidate count
+	return candidates.FindNthSet(int32((uint64(roll) * uint64(count)) >> 32));
+}
+
+uint32 FTileRules::HashCoord(int32 seed, FIntVector coord)
+{
+	uint32 hash = uint32(seed);
+	int32 components[] = { coord.X, coord.Y, coord.Z };
+
+	for (int32 component : components)
+	{
+		// Combine then mix (murmur3 finalizer)
+		hash ^= uint32(component) * 0x9E3779B1u;
+		hash ^= hash >> 16;
+		hash *= 0x85EBCA6Bu;
+		hash ^= hash >> 13;
+		hash *= 0xC2B2AE35u;
+		hash ^= hash >> 16;
+	}
+	return hash;
+}
+
+ETileDirection FTileRules::ReverseDirection(ETileDirection direction)
+{
+	return ETileDirection(uint8(direction) + ((uint8(direction) % 2) ? -1 : 1));
+}
+
+ETileDirection FTileRules::RotateDirection(ETileDirection direction, ETileRotation rotation)
+{
+	if (direction == ETileDirection::TD_ABOVE || direction == ETileDirection::TD_BELOW || rotation == ETileRotation::ROT_0)
+		return direction;
+
+	if (rotation == ETileRotation::ROT_180)
+		return ReverseDirection(direction);
+
+	if (rotation == ETileRotation::ROT_90)
+	{
+		switch (direction)
+		{
+		case ETileDirection::TD_LEFT:
+			return ETileDirection::TD_BACK;
+		case ETileDirection::TD_RIGHT:
+			return ETileDirection::TD_FRONT;
+		case ETileDirection::TD_BACK:
+			return ETileDirection::TD_RIGHT;
+		case ETileDirection::TD_FRONT:
+			return ETileDirection::TD_LEFT;
+		}
+	}
+
+	if (rotation == ETileRotation::ROT_270)
+	{
+		switch (direction)
+		{
+		case ETileDirection::TD_LEFT:
+			return ETileDirection::TD_FRONT;
+		case ETileDirection::TD_RIGHT:
+			return ETileDirection::TD_BACK;
+		case ETileDirection::TD_BACK:
+			return ETileDirection::TD_LEFT;
+		case ETileDirection::TD_FRONT:
+			return ETileDirection::TD_RIGHT;
+		}
+	}
+
+	return ETileDirection::TD_MAX;
+}
+
+ETileDirection FTileRules::ScaleDirection(ETileDirection direction, FVector scale)
+{
+	if (scale.X < 0.0f)
+	{
+		if (direction == ETileDirection::TD_LEFT)
+			return ETileDirection::TD_RIGHT;
+		if (direction == ETileDirection::TD_RIGHT)
+			return ETileDirection::TD_LEFT;
+	}
+	if (scale.Y < 0.0f)
+	{
+		if (direction == ETileDirection::TD_BACK)
+			return ETileDirection::TD_FRONT;
+		if (direction == ETileDirection::TD_FRONT)
+			return ETileDirection::TD_BACK;
+	}
+	if (scale.Z < 0.0f)
+	{
+		if (direction == ETileDirection::TD_BELOW)
+			return ETileDirection::TD_ABOVE;
+		if (direction == ETileDirection::TD_ABOVE)
+			return ETileDirection::TD_BELOW;
+	}
+
+	return direction;
+}
+
+ETileRotation FTileRules::ReverseRotation(ETileRotation rotation)
+{
+	if (rotation == ETileRotation::ROT_90)
+		return ETileRotation::ROT_270;
+
+	if (rotation == ETileRotation::ROT_270)
+		return ETileRotation::ROT_90;
+
+	return rotation;
+}
+
+ETileConnection FTileRules::GetConnection(const FTileInfo *info, ETileDirection direction, ETileRotation rotation, FVector scale)
+{
+	return info->connections[uint8(ScaleDirection(RotateDirection(direction, ReverseRotation(rotation)), scale))];
+}
@@ -0,0 +1,198 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Engine/DataTable.h"
+#include "TileRules.generated.h"
+
+class UStaticMesh;
+
+// Amounts tiles can be rotated on the z-axis
+UENUM(BlueprintType)
+enum class ETileRotation : uint8
+{
+	ROT_0   UMETA(DisplayName = "0"),
+	ROT_90  UMETA(DisplayName = "90"),
+	ROT_180 UMETA(DisplayName = "180"),
+	ROT_270 UMETA(DisplayName = "270"),
+
+	ROT_MAX UMETA(Hidden)
+};
+
+// Directions tiles are connected
+UENUM(BlueprintType)
+enum class ETileDirection : uint8
+{
+	TD_LEFT  UMETA(DisplayName = "Left"),
+	TD_RIGHT UMETA(DisplayName = "Right"),
+	TD_BACK  UMETA(DisplayName = "Back"),
+	TD_FRONT UMETA(DisplayName = "Front"),
+	TD_BELOW UMETA(DisplayName = "Below"),
+	TD_ABOVE UMETA(DisplayName = "Above"),
+
+	TD_MAX   UMETA(Hidden)
+};
+
+
+// Possible connection types (must match adjacent to generate)
+UENUM(BlueprintType)
+enum class ETileConnection : uint8
+{
+	TC_EMPTY                UMETA(DisplayName = "Empty"),
+	TC_PATH                 UMETA(DisplayName = "Path"),
+	TC_PATH_STAIRS_TOP      UMETA(DisplayName = "PathStairsTop"),
+	TC_PATH_STAIRS_TURN_TOP UMETA(DisplayName = "PathStairsTurnTop"),
+
+	TC_MAX                  UMETA(Hidden)
+};
+
+// Row from tile connections data table
+USTRUCT(BlueprintType)
+struct FTileInfo : public FTableRowBase
+{
+	GENERATED_BODY()
+
+public:
+	// Blueprint associated with this tile
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	TSubclassOf<AActor> object;
+
+	// Whether this tile should sometimes generate mirrored
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool mirror;
+
+	// Whether the player can spawn on this tile
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool canSpawnOn;
+
+	// Tiles to not generate adjacent to this tile
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	TArray<TSubclassOf<AActor>> blacklisted;
+
+	// Merged mesh of this tile without books or collision, drawn for far tiles in tiered streaming (none draws nothing)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	UStaticMesh *proxyMesh = nullptr;
+
+	// Array of connections for this tile
+	UPROPERTY(EditAnywhere)
+	ETileConnection connections[uint8(ETileDirection::TD_MAX)];
+};
+
+// Set of tile variants, one bit per variant
+struct FTileVariantMask
+{
+	// Set every bit below count
+	void Init(int32 count, bool value);
+
+	// Intersect with other mask
+	void And(const FTileVariantMask &other);
+
+	// Remove bits set in other mask
+	void AndNot(const FTileVariantMask &other);
+
+	void Set(int32 index) { words[index / 64] |= uint64(1) << (index % 64); }
+	bool Get(int32 index) const { return (words[index / 64] >> (index % 64)) & 1; }
+
+	// Number of set bits
+	int32 CountSet() const;
+
+	// Index of the nth set bit, or INDEX_NONE
+	int32 FindNthSet(int32 n) const;
+
+	TArray<uint64, TInlineAllocator<4>> words;
+};
+
+// A data table row with a rotation and mirror applied
+struct FTileVariant
+{
+	const FTileInfo *info = nullptr;
+	int32 tile = INDEX_NONE; // Index of the row this variant came from
+	ETileRotation rotation = ETileRotation::ROT_0;
+	bool mirrored = false;
+
+	// Connections after rotation and mirroring, indexed by world direction
+	ETileConnection connections[uint8(ETileDirection::TD_MAX)];
+
+	FVector GetScale() const { return mirrored ? FVector(-1, 1, 1) : FVector(1, 1, 1); }
+};
+
+// Tile data table compiled into per-direction compatibility bitsets
+class TOME_API FTileRules
+{
+public:
+	// Neighbor values besides a variant index
+	enum : int32
+	{
+		VARIANT_EMPTY = -1,    // Neighbor is loaded but empty space
+		VARIANT_UNLOADED = -2, // Neighbor is not loaded, no constraint
+	};
+
+	// Expand every row into variants and build compatibility tables
+	void Compile(const UDataTable *table);
+
+	// Table these rules were compiled from
+	const UDataTable *GetSource() const { return source_; }
+
+	int32 NumVariants() const { return variants_.Num(); }
+	int32 NumWords() const { return all_.words.Num(); }
+	const FTileVariant &GetVariant(int32 variant) const { return variants_[variant]; }
+
+	// Get all variants that fit between the given neighbors (indexed by ETileDirection)
+	void GetCandidates(const int32 neighbors[uint8(ETileDirection::TD_MAX)], bool spawn, FTileVariantMask &outCandidates) const;
+
+	// Variants allowed next to a variant (or VARIANT_EMPTY) in a direction, NumWords() long.
+	// Unlike GetCandidates, blacklists are checked both ways so any solve order gives valid pairs
+	const uint64 *GetAdjacent(int32 variant, ETileDirection direction) const;
+
+	// Whether a variant (or VARIANT_EMPTY) fits between the given neighbors
+	bool Fits(int32 variant, const int32 neighbors[uint8(ETileDirection::TD_MAX)], bool spawn) const;
+
+	// Pick a variant that fits between the given neighbors using a random roll, or VARIANT_EMPTY if none do
+	int32 Solve(const int32 neighbors[uint8(ETileDirection::TD_MAX)], bool spawn, uint32 roll, int32 *outCandidateCount = nullptr) const;
+
+	// Stateless hash of a coordinate, the same roll for a cell no matter when or where it is solved
+	static uint32 HashCoord(int32 seed, FIntVector coord);
+
+	// Get direction in opposite direction of direction
+	static ETileDirection ReverseDirection(ETileDirection direction);
+
+	// Get direction rotated on z-axis
+	static ETileDirection RotateDirection(ETileDirection direction, ETileRotation rotation);
+
+	// Scales direction (only checks for +/-)
+	static ETileDirection ScaleDirection(ETileDirection direction, FVector scale);
+
+	// Switch rotation direction (cw vs ccw)
+	static ETileRotation ReverseRotation(ETileRotation rotation);
+
+	// Get a connection of a tile given the direction of the connection and the rotation of the tile
+	static ETileConnection GetConnection(const FTileInfo *info, ETileDirection direction, ETileRotation rotation = ETileRotation::ROT_0, FVector scale = FVector(1, 1, 1));
+
+private:
+	// Index into orientation masks for a rotation and mirror
+	static int32 OrientationIndex(ETileRotation rotation, bool mirrored) { return uint8(rotation) * 2 + (mirrored ? 1 : 0); }
+
+	const UDataTable *source_ = nullptr;
+
+	TArray<FTileVariant> variants_;
+
+	// Variants with a given connection in a given direction
+	FTileVariantMask compatible_[uint8(ETileDirection::TD_MAX)][uint8(ETileConnection::TC_MAX)];
+
+	// Variants with a given rotation and mirror (vertical connections must match orientation)
+	FTileVariantMask orientation_[uint8(ETileRotation::ROT_MAX) * 2];
+
+	// Variants that may be the spawn tile
+	FTileVariantMask spawnable_;
+
+	// Variants to exclude next to each row, indexed by row
+	TArray<FTileVariantMask> blacklistedBy_;
+
+	// Every variant
+	FTileVariantMask all_;
+
+	// Words of GetAdjacent masks by variant (VARIANT_EMPTY last) then direction
+	TArray<uint64> adjacent_;
+};
@@ -0,0 +1,201 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TileRules.h"
+#include "TileChunkSolver.h"
+#include "Algo/StableSort.h"
+#include "Misc/AutomationTest.h"
+#include "UObject/Package.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace TileRulesTest
+{
+	static const int32 seed = 1234;
+	static const FIntVector regionOrigin(-4, -4, -2);
+	static const FIntVector regionSize(8, 8, 4);
+	static const FIntVector chunkSize(4, 4, 2);
+
+	// Hashes of the region solved from the rules below. If generation changes on purpose, take the new values from
+	// the test output
+	static const int32 variantCount = 36;
+	static const int64 greedyGolden = 1063798236;
+	static const int64 chunkGolden = 3846157794;
+
+	// Corresponds to ETileDirection
+	static const FIntVector directions[] = {
+		FIntVector(-1, 0, 0),
+		FIntVector(1, 0, 0),
+		FIntVector(0, -1, 0),
+		FIntVector(0, 1, 0),
+		FIntVector(0, 0, -1),
+		FIntVector(0, 0, 1)
+	};
+
+	// Row with paths out of the given sides, spawnable if it has none
+	static FTileInfo MakeTile(const TArray<ETileDirection> &paths, bool mirror = false)
+	{
+		FTileInfo info;
+		info.object = nullptr;
+		info.mirror = mirror;
+		info.canSpawnOn = paths.Num() == 0;
+		for (ETileConnection &connection : info.connections)
+			connection = ETileConnection::TC_EMPTY;
+		for (ETileDirection direction : paths)
+			info.connections[uint8(direction)] = ETileConnection::TC_PATH;
+		return info;
+	}
+
+	// Every way paths can cross a level, stairs up to the next, and crossings that can't be next to each other
+	static UDataTable *CreateTable()
+	{
+		UDataTable *table = NewObject<UDataTable>(GetTransientPackage());
+		table->RowStruct = FTileInfo::StaticStruct();
+
+		table->AddRow(TEXT("Room"), MakeTile({}));
+		table->AddRow(TEXT("End"), MakeTile({ ETileDirection::TD_LEFT }));
+		table->AddRow(TEXT("Hall"), MakeTile({ ETileDirection::TD_LEFT, ETileDirection::TD_RIGHT }));
+		table->AddRow(TEXT("Corner"), MakeTile({ ETileDirection::TD_LEFT, ETileDirection::TD_FRONT }, true));
+		table->AddRow(TEXT("Tee"), MakeTile({ ETileDirection::TD_LEFT, ETileDirection::TD_RIGHT, ETileDirection::TD_FRONT }));
+
+		FTileInfo cross = MakeTile({ ETileDirection::TD_LEFT, ETileDirection::TD_RIGHT, ETileDirection::TD_BACK, ETileDirection::TD_FRONT });
+		cross.object = AActor::StaticClass();
+		cross.blacklisted.Add(AActor::StaticClass());
+		table->AddRow(TEXT("Cross"), cross);
+
+		FTileInfo stairs = MakeTile({ ETileDirection::TD_LEFT });
+		stairs.connections[uint8(ETileDirection::TD_ABOVE)] = ETileConnection::TC_PATH_STAIRS_TOP;
+		table->AddRow(TEXT("Stairs"), stairs);
+
+		FTileInfo landing = MakeTile({ ETileDirection::TD_RIGHT });
+		landing.connections[uint8(ETileDirection::TD_BELOW)] = ETileConnection::TC_PATH_STAIRS_TOP;
+		table->AddRow(TEXT("Landing"), landing);
+
+		return table;
+	}
+
+	// Every cell of the region, in the order of the given axes from slowest to fastest changing
+	static TArray<FIntVector> Order(int32 slowest, int32 middle, int32 fastest)
+	{
+		TArray<FIntVector> order;
+		FIntVector local;
+		for (local[slowest] = 0; local[slowest] < regionSize[slowest]; local[slowest]++)
+		{
+			for (local[middle] = 0; local[middle] < regionSize[middle]; local[middle]++)
+			{
+				for (local[fastest] = 0; local[fastest] < regionSize[fastest]; local[fastest]++)
+					order.Add(regionOrigin + local);
+			}
+		}
+		return order;
+	}
+
+	// Every cell of the region, in diagonal slices away from its first corner
+	static TArray<FIntVector> WavefrontOrder()
+	{
+		TArray<FIntVector> order = Order(2, 1, 0);
+		Algo::StableSortBy(order, [](const FIntVector &coord)
+		{
+			FIntVector local = coord - regionOrigin;
+			return local.X + local.Y + local.Z;
+		});
+		return order;
+	}
+
+	// Solve one cell at a time against the cells solved before it, like GenerateTile
+	static void SolveGreedy(const FTileRules &rules, const TArray<FIntVector> &order, TMap<FIntVector, int32> &tiles)
+	{
+		for (const FIntVector &coord : order)
+		{
+			int32 neighbors[uint8(ETileDirection::TD_MAX)];
+			for (uint8 d = 0; d < uint8(ETileDirection::TD_MAX); d++)
+			{
+				const int32 *adjacent = tiles.Find(coord + directions[d]);
+				neighbors[d] = adjacent != nullptr ? *adjacent : FTileRules::VARIANT_UNLOADED;
+			}
+			tiles.Add(coord, rules.Solve(neighbors, coord == FIntVector(0, 0, 0), FTileRules::HashCoord(seed, coord)));
+		}
+	}
+
+	// Solve the chunk of each cell not solved yet, like SolveChunk
+	static void SolveChunks(const FTileRules &rules, const TArray<FIntVector> &order, TMap<FIntVector, int32> &tiles)
+	{
+		FTileChunkSolver solver(rules);
+		TArray<int32> variants;
+
+		auto known = [&tiles](FIntVector cell)
+		{
+			const int32 *variant = tiles.Find(cell);
+			return variant != nullptr ? *variant : int32(FTileRules::VARIANT_UNLOADED);
+		};
+
+		for (const FIntVector &coord : order)
+		{
+			if (tiles.Contains(coord))
+				continue;
+
+			// Chunks line up with the region
+			FIntVector local = coord - regionOrigin;
+			FIntVector origin = regionOrigin + FIntVector(local.X / chunkSize.X * chunkSize.X, local.Y / chunkSize.Y * chunkSize.Y, local.Z / chunkSize.Z * chunkSize.Z);
+
+			solver.Solve(origin, chunkSize, known, seed, true, 64, variants);
+			for (int32 i = 0; i < variants.Num(); i++)
+				tiles.Add(origin + FIntVector(i % chunkSize.X, (i / chunkSize.X) % chunkSize.Y, i / (chunkSize.X * chunkSize.Y)), variants[i]);
+		}
+	}
+
+	// FNV-1a of the region's variants in a fixed order
+	static int64 HashRegion(const TMap<FIntVector, int32> &tiles)
+	{
+		uint32 hash = 2166136261u;
+		for (const FIntVector &coord : Order(2, 1, 0))
+		{
+			uint32 variant = uint32(tiles.FindRef(coord));
+			for (int32 i = 0; i < 4; i++)
+			{
+				hash ^= (variant >> (i * 8)) & 0xFF;
+				hash *= 16777619u;
+			}
+		}
+		return hash;
+	}
+}
+
+// Hashed generation gives the same region whatever order cells are visited in, as long as each cell sees the same
+// solved neighbors, and that region doesn't drift between builds
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTileRulesGoldenTest, "Tome.TileRules.HashedGeneration", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FTileRulesGoldenTest::RunTest(const FString &Parameters)
+{
+	using namespace TileRulesTest;
+
+	FTileRules rules;
+	rules.Compile(CreateTable());
+	TestEqual(TEXT("Variants compiled"), rules.NumVariants(), variantCount);
+
+	// Orders where every cell comes after its neighbors toward the region's first corner
+	TArray<TArray<FIntVector>> orders = { Order(2, 1, 0), Order(0, 1, 2), WavefrontOrder() };
+
+	TMap<FIntVector, int32> greedy;
+	SolveGreedy(rules, orders[0], greedy);
+	TestEqual(TEXT("Greedy golden hash"), HashRegion(greedy), greedyGolden);
+
+	TMap<FIntVector, int32> chunks;
+	SolveChunks(rules, orders[0], chunks);
+	TestEqual(TEXT("Chunk golden hash"), HashRegion(chunks), chunkGolden);
+
+	for (int32 i = 1; i < orders.Num(); i++)
+	{
+		TMap<FIntVector, int32> reordered;
+		SolveGreedy(rules, orders[i], reordered);
+		TestEqual(*FString::Printf(TEXT("Greedy hash in order %d"), i), HashRegion(reordered), HashRegion(greedy));
+
+		reordered.Reset();
+		SolveChunks(rules, orders[i], reordered);
+		TestEqual(*FString::Printf(TEXT("Chunk hash in order %d"), i), HashRegion(reordered), HashRegion(chunks));
+	}
+
+	return true;
+}
+
+#endif
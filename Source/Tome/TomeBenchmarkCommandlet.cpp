@@ -0,0 +1,468 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TomeBenchmarkCommandlet.h"
+#include "Engine/DataTable.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "TileRules.h"
+#include "BookText.h"
+#include "LibraryOfBabel.h"
+#include "BookSearch.h"
+#include "Book.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogTomeBenchmark, Log, All);
+
+UTomeBenchmarkCommandlet::UTomeBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UTomeBenchmarkCommandlet::Main(const FString &params)
+{
+	FString benchmark = TEXT("Tiles");
+	FParse::Value(*params, TEXT("Benchmark="), benchmark);
+
+	FString output = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / benchmark + TEXT(".json");
+	FParse::Value(*params, TEXT("Output="), output);
+
+	TSharedRef<FJsonObject> result = MakeShared<FJsonObject>();
+	result->SetStringField(TEXT("benchmark"), benchmark);
+
+	int32 error;
+	if (benchmark == TEXT("Tiles"))
+		error = RunTiles(params, result);
+	else if (benchmark == TEXT("Pages"))
+		error = RunPages(params, result);
+	else if (benchmark == TEXT("Babel"))
+		error = RunBabel(params, result);
+	else if (benchmark == TEXT("Search"))
+		error = RunSearch(params, result);
+	else if (benchmark == TEXT("Titles"))
+		error = RunTitles(params, result);
+	else
+	{
+		UE_LOG(LogTomeBenchmark, Error, TEXT("Unknown benchmark %s"), *benchmark);
+		return 1;
+	}
+
+	if (error != 0)
+		return error;
+
+	// Process wide, so includes engine startup
+	result->SetNumberField(TEXT("peakUsedPhysicalBytes"), double(FPlatformMemory::GetStats().PeakUsedPhysical));
+
+	// Write results for CI
+	FString json;
+	TSharedRef<TJsonWriter<>> writer = TJsonWriterFactory<>::Create(&json);
+	FJsonSerializer::Serialize(result, writer);
+
+	if (!FFileHelper::SaveStringToFile(json, *output))
+	{
+		UE_LOG(LogTomeBenchmark, Error, TEXT("Could not write %s"), *output);
+		return 1;
+	}
+
+	UE_LOG(LogTomeBenchmark, Display, TEXT("Wrote %s"), *output);
+	return 0;
+}
+
+int32 UTomeBenchmarkCommandlet::RunTiles(const FString &params, TSharedRef<FJsonObject> result)
+{
+	FString tableName = TEXT("/Game/Generation/DT_TileData.DT_TileData");
+	FParse::Value(*params, TEXT("TileData="), tableName);
+
+	FString sizeString = TEXT("64x64x16");
+	FParse::Value(*params, TEXT("Size="), sizeString);
+
+	int32 seed = 0;
+	FParse::Value(*params, TEXT("Seed="), seed);
+
+	bool hashed = FParse::Param(*params, TEXT("Hashed"));
+
+	UDataTable *table = LoadObject<UDataTable>(nullptr, *tableName);
+	if (table == nullptr)
+	{
+		UE_LOG(LogTomeBenchmark, Error, TEXT("Could not load tile data %s"), *tableName);
+		return 1;
+	}
+
+	// Parse region size
+	TArray<FString> sizeParts;
+	sizeString.ParseIntoArray(sizeParts, TEXT("x"));
+	if (sizeParts.Num() != 3)
+	{
+		UE_LOG(LogTomeBenchmark, Error, TEXT("Size must look like 64x64x16, got %s"), *sizeString);
+		return 1;
+	}
+	FIntVector size(FCString::Atoi(*sizeParts[0]), FCString::Atoi(*sizeParts[1]), FCString::Atoi(*sizeParts[2]));
+
+	int64 cells = int64(size.X) * size.Y * size.Z;
+	if (size.X <= 0 || size.Y <= 0 || size.Z <= 0 || cells > MAX_int32)
+	{
+		UE_LOG(LogTomeBenchmark, Error, TEXT("Size %s is empty or too large"), *sizeString);
+		return 1;
+	}
+
+	double compileStart = FPlatformTime::Seconds();
+	FTileRules rules;
+	rules.Compile(table);
+	double compileSeconds = FPlatformTime::Seconds() - compileStart;
+
+	// Dense region, unsolved cells don't constrain
+	TArray<int32> grid;
+	grid.Init(FTileRules::VARIANT_UNLOADED, int32(cells));
+
+	// Index offsets, corresponds to ETileDirection
+	int32 strides[uint8(ETileDirection::TD_MAX)] = { -1, 1, -size.X, size.X, -size.X * size.Y, size.X * size.Y };
+
+	TArray<int64> candidateCounts;
+	candidateCounts.SetNumZeroed(rules.NumVariants() + 1);
+	int64 emptyCount = 0;
+
+	// Time slices of the run to see whether cost per tile stays constant as the region grows
+	const int32 sampleCount = 32;
+	int64 sampleSize = FMath::Max<int64>(cells / sampleCount, 1);
+	TArray<TSharedPtr<FJsonValue>> samples;
+
+	FRandomStream random(seed);
+	UE_LOG(LogTomeBenchmark, Display, TEXT("Solving %lld cells (%d variants)"), cells, rules.NumVariants());
+
+	double start = FPlatformTime::Seconds();
+	double sampleStart = start;
+	int32 index = 0;
+
+	// Solve in scan order, centered so the spawn tile is inside
+	for (int32 z = 0; z < size.Z; z++)
+	{
+		for (int32 y = 0; y < size.Y; y++)
+		{
+			for (int32 x = 0; x < size.X; x++, index++)
+			{
+				bool inside[uint8(ETileDirection::TD_MAX)] = { x > 0, x < size.X - 1, y > 0, y < size.Y - 1, z > 0, z < size.Z - 1 };
+
+				int32 neighbors[uint8(ETileDirection::TD_MAX)];
+				for (uint8 d = 0; d < uint8(ETileDirection::TD_MAX); d++)
+					neighbors[d] = inside[d] ? grid[index + strides[d]] : FTileRules::VARIANT_UNLOADED;
+
+				FIntVector coord = FIntVector(x, y, z) - size / 2;
+				uint32 roll = hashed ? FTileRules::HashCoord(seed, coord) : random.GetUnsignedInt();
+
+				int32 candidates;
+				grid[index] = rules.Solve(neighbors, coord == FIntVector(0, 0, 0), roll, &candidates);
+
+				candidateCounts[candidates]++;
+				if (candidates == 0)
+					emptyCount++;
+
+				if ((index + 1) % sampleSize == 0)
+				{
+					double now = FPlatformTime::Seconds();
+					TSharedRef<FJsonObject> sample = MakeShared<FJsonObject>();
+					sample->SetNumberField(TEXT("cells"), index + 1);
+					sample->SetNumberField(TEXT("nsPerTile"), (now - sampleStart) * 1e9 / sampleSize);
+					samples.Add(MakeShared<FJsonValueObject>(sample));
+					sampleStart = now;
+				}
+			}
+		}
+	}
+
+	double seconds = FPlatformTime::Seconds() - start;
+	double tilesPerSecond = cells / FMath::Max(seconds, 1e-9);
+
+	UE_LOG(LogTomeBenchmark, Display, TEXT("%.0f tiles/sec, %.2f%% empty, %.3fs"), tilesPerSecond, 100.0 * emptyCount / cells, seconds);
+
+	TArray<TSharedPtr<FJsonValue>> distribution;
+	for (int64 count : candidateCounts)
+		distribution.Add(MakeShared<FJsonValueNumber>(double(count)));
+
+	result->SetStringField(TEXT("tileData"), tableName);
+	result->SetStringField(TEXT("size"), sizeString);
+	result->SetNumberField(TEXT("cells"), double(cells));
+	result->SetNumberField(TEXT("variants"), rules.NumVariants());
+	result->SetBoolField(TEXT("hashed"), hashed);
+	result->SetNumberField(TEXT("compileSeconds"), compileSeconds);
+	result->SetNumberField(TEXT("seconds"), seconds);
+	result->SetNumberField(TEXT("tilesPerSecond"), tilesPerSecond);
+	result->SetNumberField(TEXT("emptyRate"), double(emptyCount) / cells);
+	result->SetArrayField(TEXT("candidateCountDistribution"), distribution);
+	result->SetArrayField(TEXT("costSamples"), samples);
+	return 0;
+}
+
+int32 UTomeBenchmarkCommandlet::RunPages(const FString &params, TSharedRef<FJsonObject> result)
+{
+	int32 books = 1000;
+	int32 pages = 410;
+	int32 lineLength = 80;
+	int32 lines = 40;
+	FParse::Value(*params, TEXT("Books="), books);
+	FParse::Value(*params, TEXT("Pages="), pages);
+	FParse::Value(*params, TEXT("LineLength="), lineLength);
+	FParse::Value(*params, TEXT("Lines="), lines);
+
+	if (books <= 0 || pages <= 0 || lineLength <= 0 || lines <= 0)
+	{
+		UE_LOG(LogTomeBenchmark, Error, TEXT("Books, Pages, LineLength and Lines must be positive"));
+		return 1;
+	}
+
+	// One buffer reused for every page, so this measures generation rather than allocation
+	int32 pageLength = lineLength * lines;
+	TArray<TCHAR> buffer;
+	buffer.SetNumUninitialized(FBookText::OutputLength(pageLength, lineLength));
+
+	int64 characters = 0;
+	uint32 checksum = 0;
+	double start = FPlatformTime::Seconds();
+
+	for (int32 book = 0; book < books; book++)
+	{
+		for (int32 page = 1; page <= pages; page++)
+		{
+			int32 length = FBookText::PageLength(book, page, pages, lineLength, lines);
+			FBookText::GenerateInto(FBookText::MakeKey(book, FBookText::KEY_PAGE, page), length, lineLength, true, buffer.GetData());
+
+			// Keep the text from being optimized away
+			checksum += buffer[length / 2];
+			characters += FBookText::OutputLength(length, lineLength);
+		}
+	}
+
+	double seconds = FPlatformTime::Seconds() - start;
+	double bytesPerSecond = characters * sizeof(TCHAR) / FMath::Max(seconds, 1e-9);
+
+	UE_LOG(LogTomeBenchmark, Display, TEXT("%.1f MB/s, %.0f pages/sec, %.3fs (checksum %u)"), bytesPerSecond / (1024.0 * 1024.0), double(books) * pages / FMath::Max(seconds, 1e-9), seconds, checksum);
+
+	result->SetNumberField(TEXT("books"), books);
+	result->SetNumberField(TEXT("pages"), pages);
+	result->SetNumberField(TEXT("lineLength"), lineLength);
+	result->SetNumberField(TEXT("lines"), lines);
+	result->SetNumberField(TEXT("characters"), double(characters));
+	result->SetNumberField(TEXT("seconds"), seconds);
+	result->SetNumberField(TEXT("bytesPerSecond"), bytesPerSecond);
+	return 0;
+}
+
+int32 UTomeBenchmarkCommandlet::RunBabel(const FString &params, TSharedRef<FJsonObject> result)
+{
+	int32 queries = 10000;
+	int32 seed = 0;
+	FParse::Value(*params, TEXT("Queries="), queries);
+	FParse::Value(*params, TEXT("Seed="), seed);
+
+	if (queries <= 0)
+	{
+		UE_LOG(LogTomeBenchmark, Error, TEXT("Queries must be positive"));
+		return 1;
+	}
+
+	// Texts of random length, made before timing
+	TArray<FString> texts;
+	for (int32 i = 0; i < queries; i++)
+	{
+		uint64 key = FBookText::MakeKey(seed, FBookText::KEY_PAGE, i);
+		texts.Add(FBookText::Generate(key, 1 + FBookText::Range(FBookText::Random(key, MAX_uint64), FLibraryOfBabel::pageLength)));
+	}
+
+	TArray<FBabelAddress> addresses;
+	addresses.SetNum(queries);
+	int32 failures = 0;
+
+	double start = FPlatformTime::Seconds();
+	for (int32 i = 0; i < queries; i++)
+	{
+		if (!FLibraryOfBabel::FindPage(texts[i], addresses[i]))
+			failures++;
+	}
+	double findSeconds = FPlatformTime::Seconds() - start;
+
+	FString page;
+	start = FPlatformTime::Seconds();
+	for (int32 i = 0; i < queries; i++)
+	{
+		// Should read back as the text followed by spaces
+		if (!FLibraryOfBabel::GetPage(addresses[i], page, 0) || !page.StartsWith(texts[i], ESearchCase::CaseSensitive) || page.Len() != FLibraryOfBabel::pageLength)
+			failures++;
+	}
+	double getSeconds = FPlatformTime::Seconds() - start;
+
+	UE_LOG(LogTomeBenchmark, Display, TEXT("Find %.2fus, get %.2fus per query, %d failures"), findSeconds * 1e6 / queries, getSeconds * 1e6 / queries, failures);
+
+	result->SetNumberField(TEXT("queries"), queries);
+	result->SetNumberField(TEXT("findMicroseconds"), findSeconds * 1e6 / queries);
+	result->SetNumberField(TEXT("getMicroseconds"), getSeconds * 1e6 / queries);
+	result->SetNumberField(TEXT("failures"), failures);
+	return failures == 0 ? 0 : 1;
+}
+
+int32 UTomeBenchmarkCommandlet::RunSearch(const FString &params, TSharedRef<FJsonObject> result)
+{
+	int32 books = 2000;
+	int32 pages = 410;
+	FString queryString = TEXT("the,babel,library");
+	FParse::Value(*params, TEXT("Books="), books);
+	FParse::Value(*params, TEXT("Pages="), pages);
+	FParse::Value(*params, TEXT("Query="), queryString, false);
+
+	// Powers of two up to every core by default
+	TArray<int32> workerCounts;
+	FString workersString;
+	if (FParse::Value(*params, TEXT("Workers="), workersString, false))
+	{
+		TArray<FString> parts;
+		workersString.ParseIntoArray(parts, TEXT(","));
+		for (const FString &part : parts)
+			workerCounts.Add(FCString::Atoi(*part));
+	}
+	else
+	{
+		for (int32 workers = 1; workers < FPlatformMisc::NumberOfCoresIncludingHyperthreads(); workers *= 2)
+			workerCounts.Add(workers);
+		workerCounts.Add(FPlatformMisc::NumberOfCoresIncludingHyperthreads());
+	}
+
+	TArray<FString> queries;
+	queryString.ParseIntoArray(queries, TEXT(","));
+
+	if (books <= 0 || pages <= 0 || queries.Num() == 0 || workerCounts.Num() == 0)
+	{
+		UE_LOG(LogTomeBenchmark, Error, TEXT("Books, Pages, Query and Workers must not be empty"));
+		return 1;
+	}
+
+	TArray<int32> seeds;
+	for (int32 i = 0; i < books; i++)
+		seeds.Add(i);
+
+	// Same text as books on shelves
+	const ABook *book = GetDefault<ABook>();
+
+	TArray<TSharedPtr<FJsonValue>> runs;
+	int32 firstHits = INDEX_NONE;
+	int32 error = 0;
+
+	for (int32 workers : workerCounts)
+	{
+		double start = FPlatformTime::Seconds();
+		TSharedRef<FBookSearch, ESPMode::ThreadSafe> search = FBookSearch::Start(queries, seeds, pages, book->pageLineLength, book->pageLineCount, workers);
+
+		// Drain hits as they come, like the game thread would
+		int32 hits = 0;
+		FBookSearchHit hit;
+		while (!search->IsDone())
+		{
+			while (search->NextHit(hit))
+				hits++;
+			FPlatformProcess::Sleep(0.0f);
+		}
+		while (search->NextHit(hit))
+			hits++;
+
+		double seconds = FPlatformTime::Seconds() - start;
+		double symbolsPerSecond = search->GetScannedSymbols() / FMath::Max(seconds, 1e-9);
+
+		UE_LOG(LogTomeBenchmark, Display, TEXT("%d workers: %.1fM symbols/sec, %d hits, %.3fs"), search->GetWorkerCount(), symbolsPerSecond / 1e6, hits, seconds);
+
+		// Every run finds the same hits
+		if (firstHits == INDEX_NONE)
+			firstHits = hits;
+		else if (hits != firstHits)
+		{
+			UE_LOG(LogTomeBenchmark, Error, TEXT("%d workers found %d hits, expected %d"), workers, hits, firstHits);
+			error = 1;
+		}
+
+		TSharedRef<FJsonObject> run = MakeShared<FJsonObject>();
+		run->SetNumberField(TEXT("workers"), search->GetWorkerCount());
+		run->SetNumberField(TEXT("seconds"), seconds);
+		run->SetNumberField(TEXT("symbolsPerSecond"), symbolsPerSecond);
+		run->SetNumberField(TEXT("hits"), hits);
+		runs.Add(MakeShared<FJsonValueObject>(run));
+	}
+
+	result->SetNumberField(TEXT("books"), books);
+	result->SetNumberField(TEXT("pages"), pages);
+	result->SetStringField(TEXT("query"), queryString);
+	result->SetArrayField(TEXT("runs"), runs);
+	return error;
+}
+
+int32 UTomeBenchmarkCommandlet::RunTitles(const FString &params, TSharedRef<FJsonObject> result)
+{
+	int32 titles = 200000;
+	int32 maxLength = GetDefault<ABook>()->coverMaxLength;
+	int32 lineLength = GetDefault<ABook>()->coverLineLength;
+	FParse::Value(*params, TEXT("Titles="), titles);
+	FParse::Value(*params, TEXT("MaxLength="), maxLength);
+	FParse::Value(*params, TEXT("LineLength="), lineLength);
+
+	if (titles <= 0 || maxLength <= 0 || maxLength > FBookText::maxTitleLength || lineLength < 2)
+	{
+		UE_LOG(LogTomeBenchmark, Error, TEXT("Titles must be positive, MaxLength 1 to %d and LineLength at least 2"), FBookText::maxTitleLength);
+		return 1;
+	}
+
+	// The chain GenerateOuterText used before FormatTitle
+	uint32 checksum = 0;
+	double start = FPlatformTime::Seconds();
+	for (int32 seed = 0; seed < titles; seed++)
+	{
+		FString spine = FBookText::GenerateTitle(seed, maxLength);
+		spine.TrimStartAndEndInline();
+		ABook::RemoveSequentialString(spine, ' ');
+		ABook::TitleCase(spine);
+
+		FString cover = spine;
+		ABook::WrapString(cover, lineLength);
+		checksum += spine.Len() + cover.Len();
+	}
+	double chainSeconds = FPlatformTime::Seconds() - start;
+
+	start = FPlatformTime::Seconds();
+	for (int32 seed = 0; seed < titles; seed++)
+	{
+		FString spine;
+		FString cover;
+		FBookText::FormatTitle(seed, maxLength, lineLength, spine, cover);
+		checksum += spine.Len() + cover.Len();
+	}
+	double formatSeconds = FPlatformTime::Seconds() - start;
+
+	// Both have to give the same text, checked outside the timing
+	int32 mismatches = 0;
+	for (int32 seed = 0; seed < titles; seed++)
+	{
+		FString spine = FBookText::GenerateTitle(seed, maxLength);
+		spine.TrimStartAndEndInline();
+		ABook::RemoveSequentialString(spine, ' ');
+		ABook::TitleCase(spine);
+		FString cover = spine;
+		ABook::WrapString(cover, lineLength);
+
+		FString formattedSpine;
+		FString formattedCover;
+		FBookText::FormatTitle(seed, maxLength, lineLength, formattedSpine, formattedCover);
+		if (!spine.Equals(formattedSpine, ESearchCase::CaseSensitive) || !cover.Equals(formattedCover, ESearchCase::CaseSensitive))
+			mismatches++;
+	}
+
+	double speedup = chainSeconds / FMath::Max(formatSeconds, 1e-9);
+	UE_LOG(LogTomeBenchmark, Display, TEXT("Chain %.1fns, FormatTitle %.1fns per title, %.1fx, %d mismatches (checksum %u)"),
+		chainSeconds * 1e9 / titles, formatSeconds * 1e9 / titles, speedup, mismatches, checksum);
+
+	result->SetNumberField(TEXT("titles"), titles);
+	result->SetNumberField(TEXT("maxLength"), maxLength);
+	result->SetNumberField(TEXT("lineLength"), lineLength);
+	result->SetNumberField(TEXT("chainNanoseconds"), chainSeconds * 1e9 / titles);
+	result->SetNumberField(TEXT("formatNanoseconds"), formatSeconds * 1e9 / titles);
+	result->SetNumberField(TEXT("speedup"), speedup);
+	result->SetNumberField(TEXT("mismatches"), mismatches);
+	return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "Dom/JsonObject.h"
+#include "TomeBenchmarkCommandlet.generated.h"
+
+// Headless benchmarks, run with: UE4Editor-Cmd Tome.uproject -run=TomeBenchmark -nullrhi -Benchmark=Tiles [options]
+UCLASS()
+class TOME_API UTomeBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UTomeBenchmarkCommandlet();
+
+	virtual int32 Main(const FString &params) override;
+
+private:
+	// Solve a region of tiles without spawning anything
+	// -TileData=<table path> -Size=XxYxZ -Seed=<int> -Hashed
+	int32 RunTiles(const FString &params, TSharedRef<FJsonObject> result);
+
+	// Generate page text for whole books
+	// -Books=<int> -Pages=<int> -LineLength=<int> -Lines=<int>
+	int32 RunPages(const FString &params, TSharedRef<FJsonObject> result);
+
+	// Look up random texts in the Library of Babel and read them back from their addresses
+	// -Queries=<int> -Seed=<int>
+	int32 RunBabel(const FString &params, TSharedRef<FJsonObject> result);
+
+	// Search books for words with increasing numbers of workers
+	// -Books=<int> -Pages=<int> -Query=<word,word> -Workers=<int,int>
+	int32 RunSearch(const FString &params, TSharedRef<FJsonObject> result);
+
+	// Format spine and cover titles with FBookText::FormatTitle against the string helpers it replaced
+	// -Titles=<int> -MaxLength=<int> -LineLength=<int>
+	int32 RunTitles(const FString &params, TSharedRef<FJsonObject> result);
+};
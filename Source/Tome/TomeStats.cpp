@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TomeStats.h"
+
+DEFINE_STAT(STAT_Tome_GeneratorTick);
+DEFINE_STAT(STAT_Tome_GenerateTile);
+DEFINE_STAT(STAT_Tome_AddTile);
+DEFINE_STAT(STAT_Tome_UnloadTile);
+DEFINE_STAT(STAT_Tome_GenerateBooks);
+DEFINE_STAT(STAT_Tome_GenerateBooksStep);
+DEFINE_STAT(STAT_Tome_GenerateOuterText);
+DEFINE_STAT(STAT_Tome_ApplyTitles);
+DEFINE_STAT(STAT_Tome_GetPage);
+
+DEFINE_STAT(STAT_Tome_LoadedTiles);
+DEFINE_STAT(STAT_Tome_Books);
+DEFINE_STAT(STAT_Tome_ShelvedBooks);
+DEFINE_STAT(STAT_Tome_PooledBooks);
+DEFINE_STAT(STAT_Tome_InstancedBooks);
+DEFINE_STAT(STAT_Tome_CachedPageBytes);
+DEFINE_STAT(STAT_Tome_Solves);
+DEFINE_STAT(STAT_Tome_CandidatesPerSolve);
+
+CSV_DEFINE_CATEGORY_MODULE(TOME_API, Tome, true);
+
+int32 FTomeStats::loadedTiles = 0;
+int32 FTomeStats::books = 0;
+int32 FTomeStats::shelvedBooks = 0;
+int32 FTomeStats::instancedBooks = 0;
+int64 FTomeStats::cachedPageBytes = 0;
+int32 FTomeStats::solves = 0;
+int64 FTomeStats::solveCandidates = 0;
+
+bool FTomeStats::Publish(float deltaTime)
+{
+	// Books that aren't on a shelf are parked in a pool or held by the player
+	int32 pooledBooks = FMath::Max(books - shelvedBooks, 0);
+	float candidatesPerSolve = solves > 0 ? float(solveCandidates) / solves : 0.0f;
+
+	SET_DWORD_STAT(STAT_Tome_LoadedTiles, loadedTiles);
+	SET_DWORD_STAT(STAT_Tome_Books, books);
+	SET_DWORD_STAT(STAT_Tome_ShelvedBooks, shelvedBooks);
+	SET_DWORD_STAT(STAT_Tome_PooledBooks, pooledBooks);
+	SET_DWORD_STAT(STAT_Tome_InstancedBooks, instancedBooks);
+	SET_MEMORY_STAT(STAT_Tome_CachedPageBytes, cachedPageBytes);
+	SET_DWORD_STAT(STAT_Tome_Solves, solves);
+	SET_FLOAT_STAT(STAT_Tome_CandidatesPerSolve, candidatesPerSolve);
+
+	CSV_CUSTOM_STAT(Tome, LoadedTiles, loadedTiles, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Tome, Books, books, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Tome, ShelvedBooks, shelvedBooks, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Tome, PooledBooks, pooledBooks, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Tome, InstancedBooks, instancedBooks, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Tome, CachedPageKB, float(cachedPageBytes) / 1024.0f, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Tome, Solves, solves, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Tome, CandidatesPerSolve, candidatesPerSolve, ECsvCustomStatOp::Set);
+
+	solves = 0;
+	solveCandidates = 0;
+
+	// Keep ticking
+	return true;
+}
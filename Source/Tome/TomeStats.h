@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+// View with "stat Tome", Unreal Insights (-trace=cpu) or "csvprofile start"
+DECLARE_STATS_GROUP(TEXT("Tome"), STATGROUP_Tome, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generator Tick"), STAT_Tome_GeneratorTick, STATGROUP_Tome, TOME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate Tile"), STAT_Tome_GenerateTile, STATGROUP_Tome, TOME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Add Tile"), STAT_Tome_AddTile, STATGROUP_Tome, TOME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Unload Tile"), STAT_Tome_UnloadTile, STATGROUP_Tome, TOME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate Books"), STAT_Tome_GenerateBooks, STATGROUP_Tome, TOME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate Books Step"), STAT_Tome_GenerateBooksStep, STATGROUP_Tome, TOME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate Outer Text"), STAT_Tome_GenerateOuterText, STATGROUP_Tome, TOME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Apply Titles"), STAT_Tome_ApplyTitles, STATGROUP_Tome, TOME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Get Page"), STAT_Tome_GetPage, STATGROUP_Tome, TOME_API);
+
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Loaded Tiles"), STAT_Tome_LoadedTiles, STATGROUP_Tome, TOME_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Books"), STAT_Tome_Books, STATGROUP_Tome, TOME_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Shelved Books"), STAT_Tome_ShelvedBooks, STATGROUP_Tome, TOME_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Pooled Books"), STAT_Tome_PooledBooks, STATGROUP_Tome, TOME_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Instanced Books"), STAT_Tome_InstancedBooks, STATGROUP_Tome, TOME_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Cached Page Bytes"), STAT_Tome_CachedPageBytes, STATGROUP_Tome, TOME_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Solves"), STAT_Tome_Solves, STATGROUP_Tome, TOME_API);
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Candidates Per Solve"), STAT_Tome_CandidatesPerSolve, STATGROUP_Tome, TOME_API);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(TOME_API, Tome);
+
+// Time a hot path as a stat, an Insights event and a CSV timing, all named Name
+#define TOME_SCOPE(Name) \
+	SCOPE_CYCLE_COUNTER(STAT_Tome_##Name); \
+	TRACE_CPUPROFILER_EVENT_SCOPE(Tome_##Name); \
+	CSV_SCOPED_TIMING_STAT(Tome, Name)
+
+// Running totals for counters, game thread only. Published as stats and CSV once a frame
+struct TOME_API FTomeStats
+{
+	static int32 loadedTiles;
+	static int32 books; // ABooks in play, on shelves, pooled or held
+	static int32 shelvedBooks; // ABooks in a row's book list
+	static int32 instancedBooks; // Books in a row's book list drawn as instances
+	static int64 cachedPageBytes; // Generated page text kept by books
+
+	// Reset every frame
+	static int32 solves;
+	static int64 solveCandidates;
+
+	// Set stats and CSV values from the totals, called by the module every frame
+	static bool Publish(float deltaTime);
+};